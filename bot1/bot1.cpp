@@ -2,43 +2,199 @@
 #include <iostream>
 #include <string>
 #include <windows.h>
-#include <vector>
 #include <cstdlib> // For rand()
 #include <ctime>
+#include <intrin.h>  // For _BitScanForward
+#include "../common/zobrist.h"
+#include "../common/classic.h"
+#include "../common/ultimate.h"
+#include "../common/protocol.h"
+#ifdef TTT_ALLOCATION_CHECK
+#include "../common/allocation_counter.h"
+#endif
+
+// First legal move in cell order, -1 if there is none
+int firstLegalMove(const SessionBoard& session) {
+    if (session.ultimate) {
+        unsigned int playable = session.ultimateBoard.playableSubBoards();
+        for (int sub = 0; sub < 9; ++sub) {
+            unsigned int moves = (playable & (1u << sub)) ? session.ultimateBoard.subBoardMoves(sub) : 0;
+            if (moves != 0) {
+                unsigned long pos;
+                _BitScanForward(&pos, moves);
+                return sub * 9 + static_cast<int>(pos);
+            }
+        }
+        return -1;
+    }
+    for (int i = 0; i < session.cellCount(); ++i) {
+        if (session.isLegal(i)) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Size of a reply to the server in characters
+const int kReplySize = 16;
+
+// Function to handle one update from the server: bring the session board up to date and
+// write the reply into reply (our move, or "R" to ask for the full board). Returns its length.
+int handleUpdate(SessionBoard& session, const wchar_t* update, wchar_t* reply) {
+    // Bring the local board up to date, or ask for the full board if we are out of sync
+    if (!session.apply(update)) {
+        std::wcout << L"Board out of sync, requesting full board." << std::endl;
+        session = SessionBoard();
+        return swprintf(reply, kReplySize, L"R\n");
+    }
+
+    wchar_t boardState[82];
+    for (int i = 0; i < session.cellCount(); ++i) {
+        boardState[i] = session[i];
+    }
+    boardState[session.cellCount()] = L'\0';
+    std::wcout << L"Received board state: " << boardState << std::endl;
+
+    // Simple strategy: Choose the first available position
+    int move = firstLegalMove(session);
+
+    // If no move available, send -1
+    if (move == -1) {
+        move = -1;
+    }
+
+    session.pendingMove = move;
+
+    // Convert move to string
+    return swprintf(reply, kReplySize, L"%d\n", move);
+}
+
+#ifdef TTT_ALLOCATION_CHECK
+// Stream buffer that discards its output, so the allocation check runs the console echo of
+// handleUpdate without printing it
+class DiscardBuffer : public std::wstreambuf {
+protected:
+    int_type overflow(int_type c) override {
+        return traits_type::not_eof(c);
+    }
+};
+
+// Function to play self-play games between two sessions through handleUpdate, with the server's
+// board as referee and the server's message formatting. Returns false if a session lost sync.
+template <typename Board>
+bool playSelfPlayGames(int games) {
+    wchar_t update[kMessageSize];
+    wchar_t reply[kReplySize];
+
+    for (int game = 0; game < games; ++game) {
+        Board referee;
+        SessionBoard players[2];
+        int deltasSent[2] = { 0, 0 };
+        int lastPos = -1;
+
+        for (int seq = 0; ; ++seq) {
+            int turn = seq % 2;
+            char mark = (turn == 0) ? 'X' : 'O';
+            if (seq < 2) {
+                formatFullSync(update, referee, seq, lastPos, mark);
+            }
+            else {
+                deltasSent[turn]++;
+                formatDelta(update, referee, seq, lastPos, deltasSent[turn] % kChecksumInterval == 0);
+            }
+
+            handleUpdate(players[turn], update, reply);
+            int move = _wtoi(reply);
+            if (reply[0] == L'R' || !referee.makeMove(move, mark)) {
+                return false;
+            }
+            lastPos = move;
+            if (referee.checkWinner() != ' ' || referee.isFull()) {
+                break;
+            }
+        }
+    }
+    return true;
+}
+
+// Function to count the heap allocations of the client's steady-state path (handleUpdate) over
+// self-play games, after a warm-up game of each ruleset
+int runAllocationCheck(int games) {
+    DiscardBuffer discard;
+    std::wstreambuf* console = std::wcout.rdbuf(&discard);
+
+    bool synced = playSelfPlayGames<TicTacToeBoard>(1) && playSelfPlayGames<UltimateBoard>(1);
+    armAllocationCounter();
+    synced = synced && playSelfPlayGames<TicTacToeBoard>(games);
+    unsigned long classic = disarmAllocationCounter();
+    armAllocationCounter();
+    synced = synced && playSelfPlayGames<UltimateBoard>(games);
+    unsigned long ultimate = disarmAllocationCounter();
+
+    std::wcout.rdbuf(console);
+    if (!synced) {
+        std::wcerr << L"Self-play lost sync." << std::endl;
+        return 1;
+    }
+
+    std::wcout << L"Heap allocations after warm-up over " << games << L" games:" << std::endl;
+    std::wcout << L"  Classic:  " << classic << std::endl;
+    std::wcout << L"  Ultimate: " << ultimate << std::endl;
+    return (classic == 0 && ultimate == 0) ? 0 : 1;
+}
+#endif
 
 int wmain(int argc, wchar_t* argv[]) {
-    if (argc < 2) {
-        std::wcerr << L"Usage: bot1.exe <pipe_name>" << std::endl;
+#ifdef TTT_ALLOCATION_CHECK
+    // bot1.exe --allocation-check [games]
+    if (argc >= 2 && std::wstring(argv[1]) == L"--allocation-check") {
+        int games = (argc >= 3) ? _wtoi(argv[2]) : 1000;
+        return runAllocationCheck(games > 0 ? games : 1000);
+    }
+#endif
+
+    if (argc < 2 || (std::wstring(argv[1]) == L"--standby" && argc < 3)) {
+        std::wcerr << L"Usage: bot1.exe <pipe_name> | --standby <control_handle>" << std::endl;
         return 1;
     }
 
     std::wstring pipeName = argv[1];
-
-    // Attempt to connect to the named pipe
     HANDLE hPipe = NULL;
-    while (true) {
-        hPipe = CreateFileW(
-            pipeName.c_str(),
-            GENERIC_READ | GENERIC_WRITE,
-            0, // No sharing
-            NULL,
-            OPEN_EXISTING,
-            0,
-            NULL
-        );
-
-        if (hPipe != INVALID_HANDLE_VALUE)
-            break;
 
-        if (GetLastError() != ERROR_PIPE_BUSY) {
-            std::wcerr << L"Could not open pipe. GLE=" << GetLastError() << std::endl;
+    if (pipeName == L"--standby") {
+        // Started ahead of time by the server, which hands us an already connected pipe
+        hPipe = receivePipeHandle(argv[2]);
+        if (hPipe == NULL) {
             return 1;
         }
+        ShowWindow(GetConsoleWindow(), SW_SHOW); // The server starts standby clients hidden
+    }
+    else {
+        // Attempt to connect to the named pipe
+        while (true) {
+            hPipe = CreateFileW(
+                pipeName.c_str(),
+                GENERIC_READ | GENERIC_WRITE,
+                0, // No sharing
+                NULL,
+                OPEN_EXISTING,
+                0,
+                NULL
+            );
 
-        // All pipe instances are busy, wait
-        if (!WaitNamedPipeW(pipeName.c_str(), 5000)) { // Wait up to 5 seconds
-            std::wcerr << L"Could not open pipe: 5-second wait timed out." << std::endl;
-            return 1;
+            if (hPipe != INVALID_HANDLE_VALUE)
+                break;
+
+            if (GetLastError() != ERROR_PIPE_BUSY) {
+                std::wcerr << L"Could not open pipe. GLE=" << GetLastError() << std::endl;
+                return 1;
+            }
+
+            // All pipe instances are busy, wait
+            if (!WaitNamedPipeW(pipeName.c_str(), 5000)) { // Wait up to 5 seconds
+                std::wcerr << L"Could not open pipe: 5-second wait timed out." << std::endl;
+                return 1;
+            }
         }
     }
 
@@ -60,8 +216,10 @@ int wmain(int argc, wchar_t* argv[]) {
     // Initialize random seed
     std::srand(static_cast<unsigned int>(std::time(NULL)));
 
+    SessionBoard session;
+
     while (true) {
-        // Read board state from server
+        // Read board update from server
         wchar_t buffer[256];
         DWORD bytesRead;
         BOOL readSuccess = ReadFile(
@@ -83,41 +241,16 @@ int wmain(int argc, wchar_t* argv[]) {
         }
 
         buffer[bytesRead / sizeof(wchar_t)] = L'\0';
-        std::wstring boardState(buffer);
-
-        std::wcout << L"Received board state: " << boardState << std::endl;
-
-        // Parse board state and decide on a move
-        // Assuming boardState is a string of 9 characters, 'X', 'O', or ' '
-
-        std::vector<char> board(9, ' ');
-        for (int i = 0; i < 9 && i < boardState.size(); ++i) {
-            board[i] = boardState[i];
-        }
-
-        // Simple strategy: Choose the first available position
-        int move = -1;
-        for (int i = 0; i < 9; ++i) {
-            if (board[i] == ' ') {
-                move = i;
-                break;
-            }
-        }
-
-        // If no move available, send -1
-        if (move == -1) {
-            move = -1;
-        }
 
-        // Convert move to string
-        std::wstring moveStr = std::to_wstring(move) + L"\n";
+        wchar_t reply[kReplySize];
+        int replyLength = handleUpdate(session, buffer, reply);
 
-        // Write move back to server
+        // Write the reply back to server
         DWORD bytesWritten;
         if (!WriteFile(
             hPipe,
-            moveStr.c_str(),
-            static_cast<DWORD>(moveStr.size() * sizeof(wchar_t)),
+            reply,
+            static_cast<DWORD>(replyLength * sizeof(wchar_t)),
             &bytesWritten,
             NULL
         )) {
@@ -125,7 +258,9 @@ int wmain(int argc, wchar_t* argv[]) {
             break;
         }
 
-        std::wcout << L"Sent move: " << move << std::endl;
+        if (reply[0] != L'R') {
+            std::wcout << L"Sent move: " << session.pendingMove << std::endl;
+        }
     }
 
     CloseHandle(hPipe);
@@ -0,0 +1,93 @@
+// allocation_counter.h
+// Replaces the global operator new so --allocation-check can count heap allocations.
+// Only included when TTT_ALLOCATION_CHECK is defined, so the normal builds keep the default
+// allocator: rebuild with it defined to run the check, e.g. "set CL=/DTTT_ALLOCATION_CHECK"
+// before msbuild /t:Rebuild. Include in exactly one source file per program.
+#pragma once
+#include <atomic>
+#include <cstdlib>      // For malloc/free
+#include <malloc.h>     // For _aligned_malloc/_aligned_free
+#include <new>
+
+// Allocations are only counted while armed, so startup and warm-up are not included
+static std::atomic<bool> allocationCountingArmed(false);
+static std::atomic<unsigned long> allocationCount(0);
+
+inline void countAllocation() {
+    if (allocationCountingArmed.load(std::memory_order_relaxed)) {
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void* operator new(size_t size) {
+    countAllocation();
+    void* p = malloc(size != 0 ? size : 1);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+#ifdef __cpp_aligned_new
+// Over-aligned types (alignas wider than the default) are allocated through these
+void* operator new(size_t size, std::align_val_t alignment) {
+    countAllocation();
+    void* p = _aligned_malloc(size != 0 ? size : 1, static_cast<size_t>(alignment));
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return operator new(size, alignment);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept {
+    _aligned_free(p);
+}
+
+void operator delete[](void* p, std::align_val_t) noexcept {
+    _aligned_free(p);
+}
+
+void operator delete(void* p, size_t, std::align_val_t) noexcept {
+    _aligned_free(p);
+}
+
+void operator delete[](void* p, size_t, std::align_val_t) noexcept {
+    _aligned_free(p);
+}
+#endif
+
+// Start counting from zero
+inline void armAllocationCounter() {
+    allocationCount.store(0, std::memory_order_relaxed);
+    allocationCountingArmed.store(true, std::memory_order_relaxed);
+}
+
+// Stop counting and return the number of allocations since armAllocationCounter
+inline unsigned long disarmAllocationCounter() {
+    allocationCountingArmed.store(false, std::memory_order_relaxed);
+    return allocationCount.load(std::memory_order_relaxed);
+}
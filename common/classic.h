@@ -0,0 +1,122 @@
+// classic.h
+// Classic 3x3 tic-tac-toe board shared by the server and the clients
+#pragma once
+#include <iostream>
+#include <windows.h>
+#include "zobrist.h"
+
+// TicTacToeBoard Class Definition
+class TicTacToeBoard {
+public:
+    static const int kCellCount = 9;
+
+    TicTacToeBoard() {
+        reset();
+    }
+
+    void reset() {
+        for (int i = 0; i < 9; ++i) {
+            board[i] = ' ';
+        }
+        for (int s = 0; s < kSymmetryCount; ++s) {
+            symmetryHashes[s] = 0;
+        }
+    }
+
+    bool isLegal(int pos) const {
+        return pos >= 0 && pos < 9 && board[pos] == ' ';
+    }
+
+    bool makeMove(int pos, char player) {
+        if (pos >= 0 && pos < 9 && board[pos] == ' ') {
+            board[pos] = player;
+            toggleHashes(pos, player);
+            return true;
+        }
+        return false;
+    }
+
+    void undoMove(int pos) {
+        if (pos >= 0 && pos < 9 && board[pos] != ' ') {
+            toggleHashes(pos, board[pos]);
+            board[pos] = ' ';
+        }
+    }
+
+    // Zobrist hash of the position, maintained incrementally
+    unsigned long long getHash() const {
+        return symmetryHashes[0];
+    }
+
+    // Same hash for all 8 rotations/reflections of the position
+    unsigned long long getCanonicalHash() const {
+        unsigned long long canonical = symmetryHashes[0];
+        for (int s = 1; s < kSymmetryCount; ++s) {
+            if (symmetryHashes[s] < canonical) {
+                canonical = symmetryHashes[s];
+            }
+        }
+        return canonical;
+    }
+
+    char operator[](int pos) const {
+        return board[pos];
+    }
+
+    void display() const {
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        for (int i = 0; i < 9; i++) {
+            if (board[i] == ' ') {
+                std::wcout << i;  // Print index for empty cells
+            }
+            else {
+                // Change color to red for X or O
+                SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY);
+                std::wcout << board[i];  // Print 'X' or 'O'
+                SetConsoleTextAttribute(hConsole, 7);  // Reset to default color
+            }
+            if ((i + 1) % 3 == 0) {
+                std::wcout << std::endl;
+            }
+            else {
+                std::wcout << L" | ";
+            }
+        }
+        std::wcout << std::endl;
+    }
+
+    char checkWinner() const {
+        static const int winPatterns[8][3] = {
+            {0, 1, 2}, {3, 4, 5}, {6, 7, 8},
+            {0, 3, 6}, {1, 4, 7}, {2, 5, 8},
+            {0, 4, 8}, {2, 4, 6}
+        };
+
+        for (auto& pattern : winPatterns) {
+            if (board[pattern[0]] == board[pattern[1]] &&
+                board[pattern[1]] == board[pattern[2]] &&
+                board[pattern[0]] != ' ') {
+                return board[pattern[0]];
+            }
+        }
+        return ' ';
+    }
+
+    bool isFull() const {
+        for (char cell : board) {
+            if (cell == ' ') return false;
+        }
+        return true;
+    }
+
+private:
+    // Hash of the board as seen through each symmetry (index 0 is the plain hash)
+    void toggleHashes(int pos, char player) {
+        for (int s = 0; s < kSymmetryCount; ++s) {
+            symmetryHashes[s] ^= zobristKey(symmetryMap[s][pos], player);
+        }
+    }
+
+    char board[9];
+    unsigned long long symmetryHashes[kSymmetryCount];
+};
@@ -0,0 +1,166 @@
+// protocol.h
+// Board update messages between the server and the clients: the server formats them, the
+// clients apply them to their SessionBoard
+#pragma once
+#include <iostream>
+#include <windows.h>
+#include <cwchar>       // For swprintf
+#include <cstdint>      // For uintptr_t
+#include "zobrist.h"
+#include "classic.h"
+#include "ultimate.h"
+
+// Every kChecksumInterval-th delta update sent to a client also carries the board hash
+const int kChecksumInterval = 4;
+
+// Full boards the server resends in a row to a client asking for a resync ("R") before it
+// gives up on the client
+const int kMaxResyncs = 1;
+
+// Size of a protocol message buffer in characters (a full ultimate board needs about 100)
+const int kMessageSize = 256;
+
+// Function to write a full board message into buffer: "F<seq>,<player>,<lastPos>,<cells>".
+// The number of cells tells the client which ruleset is being played. Returns the length.
+template <typename Board>
+int formatFullSync(wchar_t* buffer, const Board& board, int seq, int lastPos, char player) {
+    int length = swprintf(buffer, kMessageSize, L"F%d,%c,%d,", seq, static_cast<wchar_t>(player), lastPos);
+    for (int i = 0; i < Board::kCellCount; ++i) {
+        buffer[length++] = board[i];
+    }
+    buffer[length++] = L'\n';
+    buffer[length] = L'\0';
+    return length;
+}
+
+// Function to write a delta message into buffer: "D<seq>,<lastPos>[,<hash>]". Returns the length.
+template <typename Board>
+int formatDelta(wchar_t* buffer, const Board& board, int seq, int lastPos, bool withHash) {
+    if (withHash) {
+        return swprintf(buffer, kMessageSize, L"D%d,%d,%llu\n", seq, lastPos, board.getHash());
+    }
+    return swprintf(buffer, kMessageSize, L"D%d,%d\n", seq, lastPos);
+}
+
+// A client's local copy of the board, kept up to date from the server's updates. The board
+// of the ruleset being played keeps the Zobrist hash the server's checksums are compared with.
+struct SessionBoard {
+    bool ultimate = false;        // 81-cell ultimate board instead of the classic 3x3
+    TicTacToeBoard classicBoard;  // Classic rules, used in classic mode
+    UltimateBoard ultimateBoard;  // Ultimate rules (forced sub-board), used in ultimate mode
+    char me = ' ';          // Our mark, learned from the full sync
+    int seq = -1;           // Number of moves on the board, -1 until the first full sync
+    int pendingMove = -1;   // Move we sent and have not yet seen accepted or rejected
+
+    char opponent() const {
+        return (me == 'X') ? 'O' : 'X';
+    }
+
+    int cellCount() const {
+        return ultimate ? UltimateBoard::kCellCount : TicTacToeBoard::kCellCount;
+    }
+
+    char operator[](int pos) const {
+        return ultimate ? ultimateBoard[pos] : classicBoard[pos];
+    }
+
+    bool isLegal(int pos) const {
+        return ultimate ? ultimateBoard.isLegal(pos) : classicBoard.isLegal(pos);
+    }
+
+    unsigned long long getHash() const {
+        return ultimate ? ultimateBoard.getHash() : classicBoard.getHash();
+    }
+
+    bool place(int pos, char player) {
+        return ultimate ? ultimateBoard.makeMove(pos, player) : classicBoard.makeMove(pos, player);
+    }
+
+    // Apply "F<seq>,<me>,<lastPos>,<cells>" or "D<seq>,<lastPos>[,<hash>]".
+    // Returns false if the update does not fit our board and a resync is needed.
+    bool apply(const wchar_t* message) {
+        wchar_t* end = NULL;
+        if (message[0] == L'F') {
+            int newSeq = static_cast<int>(wcstol(message + 1, &end, 10));
+            if (end[0] != L',' || end[1] == L'\0' || end[2] != L',') {
+                return false;
+            }
+            me = static_cast<char>(end[1]);
+            int lastPos = static_cast<int>(wcstol(end + 3, &end, 10));
+            if (end[0] != L',') {
+                return false;
+            }
+
+            // 9 cells for the classic board, 81 for ultimate
+            const wchar_t* state = end + 1;
+            size_t count = wcscspn(state, L"\r\n");
+            if (count != 9 && count != 81) {
+                return false;
+            }
+            char cells[81];
+            for (size_t i = 0; i < count; ++i) {
+                cells[i] = static_cast<char>(state[i]);
+            }
+            ultimate = (count == 81);
+            if (ultimate) {
+                ultimateBoard.load(cells, lastPos);
+            }
+            else {
+                classicBoard.reset();
+                for (int i = 0; i < TicTacToeBoard::kCellCount; ++i) {
+                    if (cells[i] != ' ') {
+                        classicBoard.makeMove(i, cells[i]);
+                    }
+                }
+            }
+            seq = newSeq;
+            pendingMove = -1;
+            return true;
+        }
+
+        if (message[0] != L'D' || seq < 0) {
+            return false;
+        }
+        int newSeq = static_cast<int>(wcstol(message + 1, &end, 10));
+        if (end[0] != L',') {
+            return false;
+        }
+        int lastPos = static_cast<int>(wcstol(end + 1, &end, 10));
+
+        if (newSeq == seq) {
+            // Our last move was rejected, nothing changed
+        }
+        else if (pendingMove < 0 || newSeq != seq + 2 ||
+            !place(pendingMove, me) || !place(lastPos, opponent())) {
+            // Anything but "accepted, and the opponent answered" means we lost track
+            return false;
+        }
+        seq = newSeq;
+        pendingMove = -1;
+
+        if (end[0] == L',') {
+            unsigned long long expected = wcstoull(end + 1, NULL, 10);
+            if (expected != getHash()) {
+                return false;
+            }
+        }
+        return true;
+    }
+};
+
+// Read the handle value of a standby client's connection from the server's control pipe
+inline HANDLE receivePipeHandle(const wchar_t* controlHandleArg) {
+    HANDLE hControl = reinterpret_cast<HANDLE>(static_cast<uintptr_t>(wcstoull(controlHandleArg, NULL, 10)));
+
+    wchar_t buffer[64];
+    DWORD bytesRead;
+    if (!ReadFile(hControl, buffer, sizeof(buffer) - sizeof(wchar_t), &bytesRead, NULL) || bytesRead == 0) {
+        std::wcerr << L"Failed to receive pipe from server. GLE=" << GetLastError() << std::endl;
+        CloseHandle(hControl);
+        return NULL;
+    }
+    CloseHandle(hControl);
+
+    buffer[bytesRead / sizeof(wchar_t)] = L'\0';
+    return reinterpret_cast<HANDLE>(static_cast<uintptr_t>(wcstoull(buffer, NULL, 10)));
+}
@@ -0,0 +1,65 @@
+// spectator.h
+// Live game feed the server publishes in shared memory for any number of local spectators
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <cstring>      // For memcpy
+
+// Name of the file mapping holding the SpectatorFeed
+static const wchar_t kSpectatorMappingName[] = L"Local\\TicTacToeSpectator";
+
+// Retries a reader spins through before it gives up the rest of its time slice
+const int kSpectatorSpinsBeforeYield = 64;
+
+// Plain copy of the live game, published after every accepted move
+struct SpectatorState {
+    int cellCount;         // 9 for the classic board, 81 for ultimate
+    int moveCount;         // Number of moves played
+    char board[81];        // 'X', 'O' or ' ', only the first cellCount are used
+    signed char moves[81]; // Cell of each move, in the order they were played
+    char currentPlayer;    // Player to move next
+    char winner;           // 'X' or 'O' once someone has won, ' ' otherwise
+    bool gameOver;         // Set when the game ended, in a win, a draw or aborted
+    bool aborted;          // Set when the game was stopped because a client failed
+};
+
+// Shared memory layout. The sequence number is a seqlock: the server makes it odd while it
+// writes the state and even again afterwards, so readers never block the game loop and
+// simply retry when they raced with a write. It only works with a single writer, so the
+// server that creates the mapping is the only one that publishes to it.
+struct SpectatorFeed {
+    std::atomic<unsigned int> sequence;
+    SpectatorState state;
+};
+
+// Writer side (the server only)
+inline void publishSpectatorState(SpectatorFeed* feed, const SpectatorState& state) {
+    unsigned int seq = feed->sequence.load(std::memory_order_relaxed);
+    feed->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&feed->state, &state, sizeof(state));
+    feed->sequence.store(seq + 2, std::memory_order_release);
+}
+
+// Reader side: copies a consistent snapshot and returns its sequence number
+inline unsigned int readSpectatorState(const SpectatorFeed* feed, SpectatorState& state) {
+    for (int attempt = 1; ; ++attempt) {
+        unsigned int before = feed->sequence.load(std::memory_order_acquire);
+        if (!(before & 1)) { // Otherwise a write is in progress
+            memcpy(&state, &feed->state, sizeof(state));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (feed->sequence.load(std::memory_order_relaxed) == before) {
+                return before;
+            }
+        }
+
+        // Back off before retrying, so many waiting readers do not take the CPU from the
+        // game thread that is writing
+        if (attempt % kSpectatorSpinsBeforeYield == 0) {
+            SwitchToThread();
+        }
+        else {
+            YieldProcessor();
+        }
+    }
+}
@@ -0,0 +1,247 @@
+// ultimate.h
+// Ultimate tic-tac-toe board shared by the server and the clients
+#pragma once
+#include <iostream>
+#include <windows.h>
+#include "zobrist.h"
+
+// Cell numbering: cell = subBoard * 9 + position inside the sub-board, both in the usual
+// 0-8 reading order. The previous move's position (cell % 9) picks the sub-board the next
+// player must play in; if that sub-board is already won or full, any open sub-board is allowed.
+
+// Lookup table: does a 9-bit mask of one player's cells contain three in a row?
+struct LineTable {
+    bool hasLine[512];
+
+    LineTable() {
+        static const unsigned int lines[8] = {
+            0x007, 0x038, 0x1C0, // Rows
+            0x049, 0x092, 0x124, // Columns
+            0x111, 0x054         // Diagonals
+        };
+        for (unsigned int mask = 0; mask < 512; ++mask) {
+            hasLine[mask] = false;
+            for (unsigned int line : lines) {
+                if ((mask & line) == line) {
+                    hasLine[mask] = true;
+                }
+            }
+        }
+    }
+};
+
+inline bool hasLine(unsigned int mask) {
+    static const LineTable table;
+    return table.hasLine[mask];
+}
+
+// Where a cell lands under symmetry s: the whole 9x9 board turns, so the sub-board moves
+// within the big board and the cell moves within its sub-board the same way
+inline int symmetricUltimateCell(int s, int cell) {
+    return symmetryMap[s][cell / 9] * 9 + symmetryMap[s][cell % 9];
+}
+
+// UltimateBoard Class Definition
+class UltimateBoard {
+public:
+    static const int kCellCount = 81;
+
+    UltimateBoard() {
+        reset();
+    }
+
+    void reset() {
+        for (int sub = 0; sub < 9; ++sub) {
+            subX[sub] = 0;
+            subO[sub] = 0;
+        }
+        macroX = 0;
+        macroO = 0;
+        macroFull = 0;
+        forcedSub = -1;
+        historySize = 0;
+        for (int s = 0; s < kSymmetryCount; ++s) {
+            symmetryHashes[s] = 0;
+        }
+    }
+
+    // Set up a position from its 81 cells and the last move played (-1 if none).
+    // The loaded moves cannot be undone.
+    void load(const char* cells, int lastPos) {
+        reset();
+        for (int cell = 0; cell < kCellCount; ++cell) {
+            if (cells[cell] != ' ') {
+                ownCells(cells[cell])[cell / 9] |= 1u << (cell % 9);
+                toggleHashes(cell, cells[cell]);
+            }
+        }
+        for (int sub = 0; sub < 9; ++sub) {
+            updateMacro(sub);
+        }
+        forcedSub = (lastPos >= 0 && lastPos < kCellCount) ? lastPos % 9 : -1;
+    }
+
+    // 9-bit mask of the sub-boards the next move may be played in (0 once the game is over)
+    unsigned int playableSubBoards() const {
+        if (hasLine(macroX) || hasLine(macroO)) {
+            return 0;
+        }
+        unsigned int open = ~(macroX | macroO | macroFull) & 0x1FF;
+        if (forcedSub >= 0 && (open & (1u << forcedSub))) {
+            return 1u << forcedSub;
+        }
+        return open;
+    }
+
+    // 9-bit mask of the empty cells of a sub-board
+    unsigned int subBoardMoves(int sub) const {
+        return ~(subX[sub] | subO[sub]) & 0x1FF;
+    }
+
+    bool isLegal(int cell) const {
+        return cell >= 0 && cell < kCellCount &&
+            (playableSubBoards() & (1u << (cell / 9))) &&
+            (subBoardMoves(cell / 9) & (1u << (cell % 9)));
+    }
+
+    bool makeMove(int cell, char player) {
+        if (!isLegal(cell)) {
+            return false;
+        }
+        int sub = cell / 9;
+        history[historySize].cell = static_cast<signed char>(cell);
+        history[historySize].forcedSub = static_cast<signed char>(forcedSub);
+        historySize++;
+
+        ownCells(player)[sub] |= 1u << (cell % 9);
+        updateMacro(sub);
+        forcedSub = cell % 9;
+        toggleHashes(cell, player);
+        return true;
+    }
+
+    // Take back the last move made with makeMove
+    void undoMove() {
+        if (historySize == 0) {
+            return;
+        }
+        historySize--;
+        int cell = history[historySize].cell;
+        int sub = cell / 9;
+        unsigned int bit = 1u << (cell % 9);
+        char player = (subX[sub] & bit) ? 'X' : 'O';
+
+        ownCells(player)[sub] &= ~bit;
+        updateMacro(sub);
+        forcedSub = history[historySize].forcedSub;
+        toggleHashes(cell, player);
+    }
+
+    char operator[](int cell) const {
+        unsigned int bit = 1u << (cell % 9);
+        if (subX[cell / 9] & bit) return 'X';
+        if (subO[cell / 9] & bit) return 'O';
+        return ' ';
+    }
+
+    char checkWinner() const {
+        if (hasLine(macroX)) return 'X';
+        if (hasLine(macroO)) return 'O';
+        return ' ';
+    }
+
+    // True when no move is left, i.e. every sub-board is won or full
+    bool isFull() const {
+        return ((macroX | macroO | macroFull) & 0x1FF) == 0x1FF;
+    }
+
+    // Zobrist hash of the cells (the forced sub-board is not included)
+    unsigned long long getHash() const {
+        return symmetryHashes[0];
+    }
+
+    // Same hash for all 8 rotations/reflections of the cells
+    unsigned long long getCanonicalHash() const {
+        unsigned long long canonical = symmetryHashes[0];
+        for (int s = 1; s < kSymmetryCount; ++s) {
+            if (symmetryHashes[s] < canonical) {
+                canonical = symmetryHashes[s];
+            }
+        }
+        return canonical;
+    }
+
+    void display() const {
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        unsigned int playable = playableSubBoards();
+        for (int row = 0; row < 9; ++row) {
+            for (int col = 0; col < 9; ++col) {
+                int cell = ((row / 3) * 3 + col / 3) * 9 + (row % 3) * 3 + col % 3;
+                char mark = (*this)[cell];
+                if (mark == ' ') {
+                    // Print index for empty cells, dimmed outside the playable sub-boards
+                    if (!(playable & (1u << (cell / 9)))) {
+                        SetConsoleTextAttribute(hConsole, 8);
+                    }
+                    std::wcout << (cell < 10 ? L" " : L"") << cell;
+                    SetConsoleTextAttribute(hConsole, 7);
+                }
+                else {
+                    SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY);
+                    std::wcout << L" " << mark;
+                    SetConsoleTextAttribute(hConsole, 7);
+                }
+                std::wcout << ((col == 2 || col == 5) ? L" | " : L" ");
+            }
+            std::wcout << std::endl;
+            if (row == 2 || row == 5) {
+                std::wcout << L"---------+----------+---------" << std::endl;
+            }
+        }
+        std::wcout << std::endl;
+    }
+
+private:
+    // Hash of the cells as seen through each symmetry (index 0 is the plain hash)
+    void toggleHashes(int cell, char player) {
+        for (int s = 0; s < kSymmetryCount; ++s) {
+            symmetryHashes[s] ^= zobristKey(symmetricUltimateCell(s, cell), player);
+        }
+    }
+
+    unsigned short* ownCells(char player) {
+        return (player == 'X') ? subX : subO;
+    }
+
+    // Recompute whether a sub-board is won or full after one of its cells changed
+    void updateMacro(int sub) {
+        unsigned int bit = 1u << sub;
+        macroX &= ~bit;
+        macroO &= ~bit;
+        macroFull &= ~bit;
+        if (hasLine(subX[sub])) {
+            macroX |= bit;
+        }
+        else if (hasLine(subO[sub])) {
+            macroO |= bit;
+        }
+        else if ((subX[sub] | subO[sub]) == 0x1FF) {
+            macroFull |= bit;
+        }
+    }
+
+    struct UndoEntry {
+        signed char cell;
+        signed char forcedSub;
+    };
+
+    unsigned short subX[9];      // Cells held by X, one 9-bit mask per sub-board
+    unsigned short subO[9];      // Cells held by O
+    unsigned int macroX;         // Sub-boards won by X
+    unsigned int macroO;         // Sub-boards won by O
+    unsigned int macroFull;      // Sub-boards full without a winner
+    int forcedSub;               // Sub-board the next move must go in, -1 for any
+    UndoEntry history[kCellCount];
+    int historySize;
+    unsigned long long symmetryHashes[kSymmetryCount];
+};
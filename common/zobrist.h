@@ -0,0 +1,68 @@
+// zobrist.h
+// Zobrist hashing shared by the server and the clients
+#pragma once
+#include <vector>       // For std::vector
+#include <cstddef>
+
+// Key for a player's mark on a cell. Derived from the cell index with splitmix64, so every
+// process (and any board size) agrees on the keys without sharing a table.
+inline unsigned long long zobristKey(int cell, char player) {
+    unsigned long long x = static_cast<unsigned long long>(cell) * 2 + (player == 'O' ? 1 : 0);
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+// The 8 symmetries of the 3x3 board: symmetryMap[s][cell] is where cell lands under symmetry s
+static const int kSymmetryCount = 8;
+static const int symmetryMap[kSymmetryCount][9] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8}, // Identity
+    {6, 3, 0, 7, 4, 1, 8, 5, 2}, // Rotate 90
+    {8, 7, 6, 5, 4, 3, 2, 1, 0}, // Rotate 180
+    {2, 5, 8, 1, 4, 7, 0, 3, 6}, // Rotate 270
+    {2, 1, 0, 5, 4, 3, 8, 7, 6}, // Mirror left-right
+    {6, 7, 8, 3, 4, 5, 0, 1, 2}, // Mirror top-bottom
+    {0, 3, 6, 1, 4, 7, 2, 5, 8}, // Main diagonal
+    {8, 5, 2, 7, 4, 1, 6, 3, 0}  // Anti-diagonal
+};
+
+// Fixed-size, direct-mapped cache keyed by a position hash. A newer entry simply
+// replaces an older one that maps to the same slot.
+template <typename Value>
+class PositionCache {
+public:
+    // sizeLog2: the cache holds 2^sizeLog2 entries
+    explicit PositionCache(int sizeLog2 = 12)
+        : entries(static_cast<size_t>(1) << sizeLog2), mask((static_cast<size_t>(1) << sizeLog2) - 1) {
+    }
+
+    // Returns the cached value for the position, or NULL if it is not cached
+    const Value* find(unsigned long long hash) const {
+        const Entry& entry = entries[hash & mask];
+        return (entry.used && entry.hash == hash) ? &entry.value : NULL;
+    }
+
+    void store(unsigned long long hash, const Value& value) {
+        Entry& entry = entries[hash & mask];
+        entry.hash = hash;
+        entry.value = value;
+        entry.used = true;
+    }
+
+    void clear() {
+        for (Entry& entry : entries) {
+            entry.used = false;
+        }
+    }
+
+private:
+    struct Entry {
+        unsigned long long hash = 0;
+        Value value = Value();
+        bool used = false;
+    };
+
+    std::vector<Entry> entries;
+    size_t mask;
+};
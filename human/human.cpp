@@ -2,42 +2,55 @@
 #include <iostream>
 #include <string>
 #include <windows.h>
-#include <vector>
 #include <cstdlib> // For atoi()
+#include "../common/zobrist.h"
+#include "../common/classic.h"
+#include "../common/ultimate.h"
+#include "../common/protocol.h"
 
 int wmain(int argc, wchar_t* argv[]) {
-    if (argc < 2) {
-        std::wcerr << L"Usage: human.exe <pipe_name>" << std::endl;
+    if (argc < 2 || (std::wstring(argv[1]) == L"--standby" && argc < 3)) {
+        std::wcerr << L"Usage: human.exe <pipe_name> | --standby <control_handle>" << std::endl;
         return 1;
     }
 
     std::wstring pipeName = argv[1];
-
-    // Attempt to connect to the named pipe
     HANDLE hPipe = NULL;
-    while (true) {
-        hPipe = CreateFileW(
-            pipeName.c_str(),
-            GENERIC_READ | GENERIC_WRITE,
-            0, // No sharing
-            NULL,
-            OPEN_EXISTING,
-            0,
-            NULL
-        );
 
-        if (hPipe != INVALID_HANDLE_VALUE)
-            break;
-
-        if (GetLastError() != ERROR_PIPE_BUSY) {
-            std::wcerr << L"Could not open pipe. GLE=" << GetLastError() << std::endl;
+    if (pipeName == L"--standby") {
+        // Started ahead of time by the server, which hands us an already connected pipe
+        hPipe = receivePipeHandle(argv[2]);
+        if (hPipe == NULL) {
             return 1;
         }
+        ShowWindow(GetConsoleWindow(), SW_SHOW); // The server starts standby clients hidden
+    }
+    else {
+        // Attempt to connect to the named pipe
+        while (true) {
+            hPipe = CreateFileW(
+                pipeName.c_str(),
+                GENERIC_READ | GENERIC_WRITE,
+                0, // No sharing
+                NULL,
+                OPEN_EXISTING,
+                0,
+                NULL
+            );
+
+            if (hPipe != INVALID_HANDLE_VALUE)
+                break;
+
+            if (GetLastError() != ERROR_PIPE_BUSY) {
+                std::wcerr << L"Could not open pipe. GLE=" << GetLastError() << std::endl;
+                return 1;
+            }
 
-        // All pipe instances are busy, wait
-        if (!WaitNamedPipeW(pipeName.c_str(), 5000)) { // Wait up to 5 seconds
-            std::wcerr << L"Could not open pipe: 5-second wait timed out." << std::endl;
-            return 1;
+            // All pipe instances are busy, wait
+            if (!WaitNamedPipeW(pipeName.c_str(), 5000)) { // Wait up to 5 seconds
+                std::wcerr << L"Could not open pipe: 5-second wait timed out." << std::endl;
+                return 1;
+            }
         }
     }
 
@@ -56,8 +69,10 @@ int wmain(int argc, wchar_t* argv[]) {
         return 1;
     }
 
+    SessionBoard session;
+
     while (true) {
-        // Read board state from server
+        // Read board update from server
         wchar_t buffer[256];
         DWORD bytesRead;
         BOOL readSuccess = ReadFile(
@@ -79,33 +94,55 @@ int wmain(int argc, wchar_t* argv[]) {
         }
 
         buffer[bytesRead / sizeof(wchar_t)] = L'\0';
-        std::wstring boardState(buffer);
 
+        // Bring the local board up to date, or ask for the full board if we are out of sync
+        if (!session.apply(buffer)) {
+            std::wcout << L"Board out of sync, requesting full board." << std::endl;
+            session = SessionBoard();
+            const wchar_t resyncRequest[] = L"R\n";
+            DWORD bytesWritten;
+            if (!WriteFile(hPipe, resyncRequest, sizeof(resyncRequest) - sizeof(wchar_t), &bytesWritten, NULL)) {
+                std::wcerr << L"Failed to write to pipe. GLE=" << GetLastError() << std::endl;
+                break;
+            }
+            continue;
+        }
+
+        wchar_t boardState[82];
+        for (int i = 0; i < session.cellCount(); ++i) {
+            boardState[i] = session[i];
+        }
+        boardState[session.cellCount()] = L'\0';
         std::wcout << L"Received board state: " << boardState << std::endl;
 
-        // Display board state (optional)
-        // You can parse and display the board more nicely if desired
+        // Display board state
+        if (session.ultimate) {
+            session.ultimateBoard.display();
+        }
 
         // Prompt user for move
         int move = -1;
-        std::wcout << L"Enter your move (0-8): ";
+        std::wcout << L"Enter your move (0-" << session.cellCount() - 1 << L"): ";
         std::wcin >> move;
 
         // Validate move
-        if (move < 0 || move > 8) {
+        if (move < 0 || move >= session.cellCount()) {
             std::wcerr << L"Invalid move input: " << move << std::endl;
             move = -1; // Indicate invalid move
         }
 
+        session.pendingMove = move;
+
         // Convert move to string
-        std::wstring moveStr = std::to_wstring(move) + L"\n";
+        wchar_t moveStr[16];
+        int moveLength = swprintf(moveStr, 16, L"%d\n", move);
 
         // Write move back to server
         DWORD bytesWritten;
         if (!WriteFile(
             hPipe,
-            moveStr.c_str(),
-            static_cast<DWORD>(moveStr.size() * sizeof(wchar_t)),
+            moveStr,
+            static_cast<DWORD>(moveLength * sizeof(wchar_t)),
             &bytesWritten,
             NULL
         )) {
@@ -0,0 +1,187 @@
+// spectator.cpp
+#include <iostream>
+#include <string>
+#include <windows.h>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include "../common/spectator.h"
+
+// Function to check that a snapshot is internally consistent (a torn copy would not be)
+bool isConsistent(const SpectatorState& state) {
+    if ((state.cellCount != 9 && state.cellCount != 81) ||
+        state.moveCount < 0 || state.moveCount > state.cellCount) {
+        return false;
+    }
+
+    int occupied = 0;
+    for (int i = 0; i < state.cellCount; ++i) {
+        if (state.board[i] != ' ') {
+            occupied++;
+        }
+    }
+    if (occupied != state.moveCount) {
+        return false;
+    }
+
+    // X always moves first and players alternate
+    for (int i = 0; i < state.moveCount; ++i) {
+        int cell = state.moves[i];
+        if (cell < 0 || cell >= state.cellCount || state.board[cell] != ((i % 2 == 0) ? 'X' : 'O')) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Function to print the board and the move history
+void display(const SpectatorState& state) {
+    if (state.cellCount == 81) {
+        // Ultimate: cell = subBoard * 9 + position, laid out as a 9x9 grid
+        for (int row = 0; row < 9; ++row) {
+            for (int col = 0; col < 9; ++col) {
+                int cell = ((row / 3) * 3 + col / 3) * 9 + (row % 3) * 3 + col % 3;
+                std::wcout << (state.board[cell] == ' ' ? '.' : state.board[cell]);
+                std::wcout << ((col == 2 || col == 5) ? L" | " : L" ");
+            }
+            std::wcout << std::endl;
+            if (row == 2 || row == 5) {
+                std::wcout << L"------+-------+------" << std::endl;
+            }
+        }
+    }
+    else {
+        for (int i = 0; i < 9; i++) {
+            if (state.board[i] == ' ') {
+                std::wcout << i;  // Print index for empty cells
+            }
+            else {
+                std::wcout << state.board[i];
+            }
+            if ((i + 1) % 3 == 0) {
+                std::wcout << std::endl;
+            }
+            else {
+                std::wcout << L" | ";
+            }
+        }
+    }
+
+    std::wcout << L"Moves:";
+    for (int i = 0; i < state.moveCount; ++i) {
+        std::wcout << L" " << static_cast<int>(state.moves[i]);
+    }
+    std::wcout << std::endl << std::endl;
+}
+
+// Function to follow the live game until it ends
+void watch(const SpectatorFeed* feed) {
+    unsigned int lastSeq = 0; // Nothing has been published yet
+    while (true) {
+        SpectatorState state;
+        unsigned int seq = readSpectatorState(feed, state);
+        if (seq != lastSeq) {
+            lastSeq = seq;
+            display(state);
+            if (state.gameOver) {
+                if (state.aborted) {
+                    std::wcout << L"Game aborted: a player disconnected." << std::endl;
+                }
+                else if (state.winner != ' ') {
+                    std::wcout << L"Winner: " << state.winner << std::endl;
+                }
+                else {
+                    std::wcout << L"It's a draw!" << std::endl;
+                }
+                return;
+            }
+        }
+        Sleep(10);
+    }
+}
+
+// Function to hammer the feed with many concurrent readers while a writer is publishing, and
+// verify that none of them ever sees a torn snapshot. Run it against main.exe
+// --spectator-writer, which publishes local games back to back, to race against a writer
+// that never pauses.
+int runLoadTest(const SpectatorFeed* feed, int readers, int seconds) {
+    std::atomic<bool> stop(false);
+    std::atomic<unsigned long long> totalReads(0);
+    std::atomic<unsigned long long> totalUpdates(0);
+    std::atomic<unsigned long long> totalInconsistent(0);
+
+    std::vector<std::thread> threads;
+    for (int r = 0; r < readers; ++r) {
+        threads.emplace_back([&]() {
+            unsigned long long reads = 0;
+            unsigned long long updates = 0;
+            unsigned long long inconsistent = 0;
+            unsigned int lastSeq = 0; // Nothing has been published yet
+            while (!stop.load(std::memory_order_relaxed)) {
+                SpectatorState state;
+                unsigned int seq = readSpectatorState(feed, state);
+                reads++;
+                if (seq != lastSeq) {
+                    lastSeq = seq;
+                    updates++;
+                }
+                if (seq != 0 && !isConsistent(state)) {
+                    inconsistent++;
+                }
+            }
+            totalReads += reads;
+            totalUpdates += updates;
+            totalInconsistent += inconsistent;
+        });
+    }
+
+    Sleep(static_cast<DWORD>(seconds) * 1000);
+    stop = true;
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    std::wcout << readers << L" readers over " << seconds << L" s:" << std::endl;
+    std::wcout << L"  Snapshots read:      " << totalReads << L" (" << totalReads / seconds << L"/s)" << std::endl;
+    std::wcout << L"  Updates observed:    " << totalUpdates << std::endl;
+    std::wcout << L"  Inconsistent copies: " << totalInconsistent << std::endl;
+    return (totalInconsistent == 0) ? 0 : 1;
+}
+
+int wmain(int argc, wchar_t* argv[]) {
+    bool loadTest = (argc >= 3 && std::wstring(argv[1]) == L"--load-test");
+    if (argc >= 2 && !loadTest) {
+        std::wcerr << L"Usage: spectator.exe [--load-test <readers> [seconds]]" << std::endl;
+        return 1;
+    }
+
+    // Wait for a server to publish a game
+    HANDLE hMapping = NULL;
+    while ((hMapping = OpenFileMappingW(FILE_MAP_READ, FALSE, kSpectatorMappingName)) == NULL) {
+        std::wcout << L"Waiting for a game..." << std::endl;
+        Sleep(500);
+    }
+
+    const SpectatorFeed* feed = static_cast<const SpectatorFeed*>(MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, sizeof(SpectatorFeed)));
+    if (feed == NULL) {
+        std::wcerr << L"Failed to map spectator feed. GLE=" << GetLastError() << std::endl;
+        CloseHandle(hMapping);
+        return 1;
+    }
+
+    std::wcout << L"Watching live game." << std::endl;
+
+    int result = 0;
+    if (loadTest) {
+        int readers = _wtoi(argv[2]);
+        int seconds = (argc >= 4) ? _wtoi(argv[3]) : 10;
+        result = runLoadTest(feed, readers > 0 ? readers : 100, seconds > 0 ? seconds : 10);
+    }
+    else {
+        watch(feed);
+    }
+
+    UnmapViewOfFile(feed);
+    CloseHandle(hMapping);
+    return result;
+}
@@ -0,0 +1,321 @@
+// metrics.h
+// Server metrics: sharded counters and gauges, exported as a Prometheus text file
+#pragma once
+#include <windows.h>
+#include <atomic>
+#include <thread>
+#include <string>
+#include <cstdio>       // For snprintf
+#include <intrin.h>     // For __rdtsc, __cpuid
+
+enum Counter {
+    kGamesStarted,
+    kGamesFinished,
+    kGamesAborted,      // Game loop left because a client failed
+    kMovesTotal,
+    kInvalidMoves,      // Moves the game loop rejected and asked for again
+    kClientErrors,      // Failed pipe reads/writes (disconnected or dead client)
+    kTimeouts,          // Clients that did not answer within their move timeout
+    kResyncs,           // Full boards resent on a client's request
+    kCounterCount
+};
+
+enum Gauge {
+    kActiveGames,
+    kConnectedClients,
+    kGaugeCount
+};
+
+// Which player a latency sample belongs to
+enum ClientSlot {
+    kSlotHuman1,
+    kSlotHuman2,
+    kSlotBot1,
+    kSlotBot2,
+    kClientSlotCount
+};
+
+// Shards owned by one thread each; threads beyond that share one more shard
+const int kMetricShards = 16;
+const int kLatencyBuckets = 11;
+// Upper bounds of the move latency histogram buckets, in microseconds (the last is +Inf)
+static const unsigned long long kLatencyBucketBounds[kLatencyBuckets - 1] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 50000, 250000, 1000000
+};
+
+// One shard per thread, each on its own cache lines, so threads recording metrics never
+// contend on the same counter. The exporter sums the shards.
+struct alignas(64) MetricShard {
+    std::atomic<unsigned long long> counters[kCounterCount];
+    std::atomic<long long> gauges[kGaugeCount];        // Sum over shards is the gauge value
+    std::atomic<unsigned long long> latencyBuckets[kClientSlotCount][kLatencyBuckets];
+    std::atomic<unsigned long long> latencySumTicks[kClientSlotCount];
+};
+
+// Whether the CPU's timestamp counter ticks at a constant rate in every power state (invariant TSC)
+inline bool hasInvariantTsc() {
+    int info[4];
+    __cpuid(info, 0x80000000);
+    if (static_cast<unsigned int>(info[0]) < 0x80000007) {
+        return false;
+    }
+    __cpuid(info, 0x80000007);
+    return (info[3] & (1 << 8)) != 0;
+}
+
+// Whether clockTicks reads the timestamp counter directly, which costs a fraction of a
+// QueryPerformanceCounter call on the move path
+inline bool clockUsesTsc() {
+    static const bool useTsc = hasInvariantTsc();
+    return useTsc;
+}
+
+// Read the high-resolution clock the server times everything with: the timestamp counter if
+// it is invariant, QueryPerformanceCounter ticks otherwise
+inline unsigned long long clockTicks() {
+    if (clockUsesTsc()) {
+        return __rdtsc();
+    }
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    return now.QuadPart;
+}
+
+// Ticks per second of clockTicks. The timestamp counter's rate is measured once against
+// QueryPerformanceCounter over 10 ms.
+inline long long clockFrequency() {
+    static const long long frequency = []() {
+        LARGE_INTEGER qpcFrequency;
+        QueryPerformanceFrequency(&qpcFrequency);
+        if (!clockUsesTsc()) {
+            return qpcFrequency.QuadPart;
+        }
+        LARGE_INTEGER qpcStart;
+        LARGE_INTEGER qpcNow;
+        QueryPerformanceCounter(&qpcStart);
+        unsigned long long tscStart = __rdtsc();
+        do {
+            QueryPerformanceCounter(&qpcNow);
+        } while (qpcNow.QuadPart - qpcStart.QuadPart < qpcFrequency.QuadPart / 100);
+        unsigned long long tscTicks = __rdtsc() - tscStart;
+        return static_cast<long long>(tscTicks * qpcFrequency.QuadPart / (qpcNow.QuadPart - qpcStart.QuadPart));
+    }();
+    return frequency;
+}
+
+// Convert a clockTicks interval to milliseconds
+inline double ticksToMillis(unsigned long long ticks) {
+    return ticks * 1000.0 / clockFrequency();
+}
+
+// MetricsRegistry Class Definition. Must have static storage duration, which zero-initializes
+// the shards.
+class MetricsRegistry {
+public:
+    MetricsRegistry() {
+        ticksPerSecond = clockFrequency();
+        for (int bucket = 0; bucket < kLatencyBuckets - 1; ++bucket) {
+            latencyBucketTicks[bucket] = kLatencyBucketBounds[bucket] * ticksPerSecond / 1000000;
+        }
+    }
+
+    // Recording can be switched off to measure what it costs
+    void setEnabled(bool on) {
+        enabled = on;
+    }
+
+    bool isEnabled() const {
+        return enabled;
+    }
+
+    void increment(Counter counter, unsigned long long amount = 1) {
+        if (!enabled) {
+            return;
+        }
+        int index = shardIndex();
+        add(shards[index].counters[counter], amount, index);
+    }
+
+    void addToGauge(Gauge gauge, long long delta) {
+        if (!enabled) {
+            return;
+        }
+        int index = shardIndex();
+        add(shards[index].gauges[gauge], delta, index);
+    }
+
+    // Latencies stay in clock ticks (see clockTicks) so the hot path does no division;
+    // they are converted to seconds on export
+    void observeLatency(ClientSlot slot, unsigned long long ticks) {
+        if (!enabled) {
+            return;
+        }
+        int bucket = 0;
+        while (bucket < kLatencyBuckets - 1 && ticks > latencyBucketTicks[bucket]) {
+            bucket++;
+        }
+        int index = shardIndex();
+        add(shards[index].latencyBuckets[slot][bucket], 1ull, index);
+        add(shards[index].latencySumTicks[slot], ticks, index);
+    }
+
+    unsigned long long counterValue(Counter counter) const {
+        unsigned long long total = 0;
+        for (const MetricShard& s : shards) {
+            total += s.counters[counter].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    long long gaugeValue(Gauge gauge) const {
+        long long total = 0;
+        for (const MetricShard& s : shards) {
+            total += s.gauges[gauge].load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // Start rewriting path with the current values every intervalMs on a background thread
+    bool startExport(const std::wstring& path, DWORD intervalMs) {
+        exportPath = path;
+        exportIntervalMs = intervalMs;
+        hStopExport = CreateEventW(NULL, TRUE, FALSE, NULL);
+        if (hStopExport == NULL) {
+            return false;
+        }
+        exportThread = std::thread([this]() {
+            unsigned long long lastMoves = 0;
+            do {
+                unsigned long long moves = counterValue(kMovesTotal);
+                double movesPerSecond = (moves - lastMoves) * 1000.0 / exportIntervalMs;
+                lastMoves = moves;
+                writeExportFile(movesPerSecond);
+            } while (WaitForSingleObject(hStopExport, exportIntervalMs) != WAIT_OBJECT_0);
+        });
+        return true;
+    }
+
+    // Write the final values and stop the export thread
+    void stopExport() {
+        if (hStopExport == NULL) {
+            return;
+        }
+        SetEvent(hStopExport);
+        exportThread.join();
+        CloseHandle(hStopExport);
+        hStopExport = NULL;
+    }
+
+private:
+    // Shard of the calling thread. The first kMetricShards threads to record a metric get one
+    // each; any later thread gets the shared shard at index kMetricShards.
+    int shardIndex() {
+        struct ShardClaim {
+            const MetricsRegistry* registry = NULL;
+            int index = 0;
+        };
+        static thread_local ShardClaim claim;
+        if (claim.registry != this) {
+            int index = nextShard.fetch_add(1, std::memory_order_relaxed);
+            claim.registry = this;
+            claim.index = (index < kMetricShards) ? index : kMetricShards;
+        }
+        return claim.index;
+    }
+
+    // Add to a value in shard index. Only its owner writes to an owned shard, so a plain
+    // load and store is enough there; the shared shard needs the atomic read-modify-write.
+    template <typename T>
+    static void add(std::atomic<T>& value, T amount, int index) {
+        if (index < kMetricShards) {
+            value.store(value.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+        }
+        else {
+            value.fetch_add(amount, std::memory_order_relaxed);
+        }
+    }
+
+    // Format all metrics in the Prometheus text exposition format; returns the length
+    int format(char* buffer, int size, double movesPerSecond) const {
+        static const char* const counterNames[kCounterCount] = {
+            "ttt_games_started_total", "ttt_games_finished_total", "ttt_games_aborted_total",
+            "ttt_moves_total", "ttt_invalid_moves_total", "ttt_client_errors_total", "ttt_client_timeouts_total",
+            "ttt_resyncs_total"
+        };
+        static const char* const gaugeNames[kGaugeCount] = {
+            "ttt_active_games", "ttt_connected_clients"
+        };
+        static const char* const slotNames[kClientSlotCount] = {
+            "human1", "human2", "bot1", "bot2"
+        };
+
+        int length = 0;
+        for (int c = 0; c < kCounterCount; ++c) {
+            length += snprintf(buffer + length, size - length, "# TYPE %s counter\n%s %llu\n",
+                counterNames[c], counterNames[c], counterValue(static_cast<Counter>(c)));
+        }
+        for (int g = 0; g < kGaugeCount; ++g) {
+            length += snprintf(buffer + length, size - length, "# TYPE %s gauge\n%s %lld\n",
+                gaugeNames[g], gaugeNames[g], gaugeValue(static_cast<Gauge>(g)));
+        }
+        length += snprintf(buffer + length, size - length,
+            "# TYPE ttt_moves_per_second gauge\nttt_moves_per_second %.2f\n", movesPerSecond);
+
+        length += snprintf(buffer + length, size - length, "# TYPE ttt_move_latency_seconds histogram\n");
+        for (int slot = 0; slot < kClientSlotCount; ++slot) {
+            unsigned long long cumulative = 0;
+            unsigned long long sumTicks = 0;
+            for (int bucket = 0; bucket < kLatencyBuckets; ++bucket) {
+                for (const MetricShard& s : shards) {
+                    cumulative += s.latencyBuckets[slot][bucket].load(std::memory_order_relaxed);
+                }
+                if (bucket < kLatencyBuckets - 1) {
+                    length += snprintf(buffer + length, size - length,
+                        "ttt_move_latency_seconds_bucket{client=\"%s\",le=\"%g\"} %llu\n",
+                        slotNames[slot], kLatencyBucketBounds[bucket] / 1e6, cumulative);
+                }
+                else {
+                    length += snprintf(buffer + length, size - length,
+                        "ttt_move_latency_seconds_bucket{client=\"%s\",le=\"+Inf\"} %llu\n",
+                        slotNames[slot], cumulative);
+                }
+            }
+            for (const MetricShard& s : shards) {
+                sumTicks += s.latencySumTicks[slot].load(std::memory_order_relaxed);
+            }
+            length += snprintf(buffer + length, size - length,
+                "ttt_move_latency_seconds_sum{client=\"%s\"} %g\nttt_move_latency_seconds_count{client=\"%s\"} %llu\n",
+                slotNames[slot], static_cast<double>(sumTicks) / ticksPerSecond, slotNames[slot], cumulative);
+        }
+        return length;
+    }
+
+    // Write to a temporary file and rename it over the export file, so readers never see
+    // a partially written file
+    void writeExportFile(double movesPerSecond) const {
+        static char buffer[16384];
+        int length = format(buffer, sizeof(buffer), movesPerSecond);
+
+        std::wstring tempPath = exportPath + L".tmp";
+        HANDLE hFile = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (hFile == INVALID_HANDLE_VALUE) {
+            return;
+        }
+        DWORD bytesWritten;
+        BOOL written = WriteFile(hFile, buffer, static_cast<DWORD>(length), &bytesWritten, NULL);
+        CloseHandle(hFile);
+        if (written) {
+            MoveFileExW(tempPath.c_str(), exportPath.c_str(), MOVEFILE_REPLACE_EXISTING);
+        }
+    }
+
+    MetricShard shards[kMetricShards + 1];  // The last one is shared
+    std::atomic<int> nextShard{ 0 };        // Owned shards handed out so far
+    bool enabled = true;
+    long long ticksPerSecond;
+    unsigned long long latencyBucketTicks[kLatencyBuckets - 1];
+    std::wstring exportPath;
+    DWORD exportIntervalMs = 1000;
+    HANDLE hStopExport = NULL;
+    std::thread exportThread;
+};
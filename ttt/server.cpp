@@ -1,100 +1,98 @@
 // server.cpp
 #include <iostream>
 #include <vector>       // For std::vector
+#include <algorithm>    // For std::nth_element
 #include <windows.h>
 #include <io.h>
 #include <fcntl.h>
-#include <sstream>      // For std::wstringstream
 #include <string>
+#include <thread>
+#include <mutex>
+#include <intrin.h>     // For _BitScanForward
+#include "../common/zobrist.h"
+#include "../common/classic.h"
+#include "../common/spectator.h"
+#include "../common/ultimate.h"
+#include "../common/protocol.h"
+#ifdef TTT_ALLOCATION_CHECK
+#include "../common/allocation_counter.h"
+#endif
+#include "metrics.h"
+
+// Paths to client executables
+const wchar_t kHumanExePath[] = L"human.exe"; // Ensure human.exe exists in the same directory
+const wchar_t kBot1ExePath[] = L"bot1.exe";   // Ensure bot1.exe exists in the same directory
+const wchar_t kBot2ExePath[] = L"bot2.exe";   // Ensure bot2.exe exists in the same directory
+
+// How long a client may take to answer a board update before the server gives up on it.
+// Bots answer right away; a person gets time to think.
+const DWORD kBotMoveTimeoutMs = 5000;
+const DWORD kHumanMoveTimeoutMs = 10 * 60 * 1000;
 
 // Structure to hold client process information
 struct ClientProcess {
-    std::wstring pipeName; // Name of the named pipe
-    HANDLE hPipe;          // Handle to the named pipe
-    HANDLE hProcess;       // Handle to the client process
+    std::wstring pipeName;   // Name of the named pipe
+    HANDLE hPipe = NULL;     // Handle to the named pipe, opened for overlapped I/O
+    HANDLE hIoEvent = NULL;  // Event the overlapped operations on hPipe complete on
+    HANDLE hProcess = NULL;  // Handle to the client process
+    DWORD moveTimeoutMs = kBotMoveTimeoutMs; // How long each reply may take
+    int syncedSeq = -1;      // Last sequence number sent to the client, -1 until the first full sync
+    int deltasSent = 0;      // Delta updates sent to the client, decides when the hash is included
+    ClientSlot metricsSlot = kSlotBot1; // Which player its move latency is recorded as
+    bool connected = false;  // Counted in the connected clients gauge
 };
 
-// TicTacToeBoard Class Definition
-class TicTacToeBoard {
-public:
-    TicTacToeBoard() {
-        reset();
-    }
+// Server-wide metrics, exported to a Prometheus text file while a game runs
+static MetricsRegistry metrics;
 
-    void reset() {
-        board = std::vector<char>(9, ' ');
-    }
+// Structure to hold a client process that was started ahead of time and is
+// blocked waiting for its pipe handle (see spawnStandbyClient)
+struct StandbyClient {
+    std::wstring exePath;    // Executable the process was started from
+    HANDLE hProcess = NULL;  // Handle to the client process
+    HANDLE hControl = NULL;  // Write end of the pipe the connection handle is sent through
+};
 
-    bool makeMove(int pos, char player) {
-        if (pos >= 0 && pos < 9 && board[pos] == ' ') {
-            board[pos] = player;
-            return true;
-        }
-        return false;
+// Function to keep the connected clients gauge in step with a client's pipe
+void setConnected(ClientProcess& client, bool connected) {
+    if (client.connected != connected) {
+        client.connected = connected;
+        metrics.addToGauge(kConnectedClients, connected ? 1 : -1);
     }
+}
 
-    char& operator[](int pos) {
-        return board[pos];
+// Function to close the server end of a client's pipe and its I/O event
+void closeClientPipe(ClientProcess& client) {
+    if (client.hPipe != NULL && client.hPipe != INVALID_HANDLE_VALUE) {
+        CloseHandle(client.hPipe);
+        client.hPipe = NULL;
     }
-
-    void display() const {
-        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-        for (int i = 0; i < 9; i++) {
-            if (board[i] == ' ') {
-                std::wcout << i;  // Print index for empty cells
-            }
-            else {
-                // Change color to red for X or O
-                SetConsoleTextAttribute(hConsole, FOREGROUND_RED | FOREGROUND_INTENSITY);
-                std::wcout << board[i];  // Print 'X' or 'O'
-                SetConsoleTextAttribute(hConsole, 7);  // Reset to default color
-            }
-            if ((i + 1) % 3 == 0) {
-                std::wcout << std::endl;
-            }
-            else {
-                std::wcout << L" | ";
-            }
-        }
-        std::wcout << std::endl;
-    }
-
-    char checkWinner() const {
-        static const int winPatterns[8][3] = {
-            {0, 1, 2}, {3, 4, 5}, {6, 7, 8},
-            {0, 3, 6}, {1, 4, 7}, {2, 5, 8},
-            {0, 4, 8}, {2, 4, 6}
-        };
-
-        for (auto& pattern : winPatterns) {
-            if (board[pattern[0]] == board[pattern[1]] &&
-                board[pattern[1]] == board[pattern[2]] &&
-                board[pattern[0]] != ' ') {
-                return board[pattern[0]];
-            }
-        }
-        return ' ';
+    if (client.hIoEvent != NULL) {
+        CloseHandle(client.hIoEvent);
+        client.hIoEvent = NULL;
     }
+}
 
-    bool isFull() const {
-        for (char cell : board) {
-            if (cell == ' ') return false;
-        }
-        return true;
+// Function to close a client's pipe and end its process
+void closeClient(ClientProcess& client) {
+    setConnected(client, false);
+    if (client.hProcess != NULL) {
+        TerminateProcess(client.hProcess, 0);
+        CloseHandle(client.hProcess);
+        client.hProcess = NULL;
     }
+    closeClientPipe(client);
+}
 
-private:
-    std::vector<char> board;
-};
-
-// Function to create a named pipe, launch client process, and wait for connection
-bool createClientProcess(const std::wstring& pipeName, const std::wstring& exePath, ClientProcess& client) {
+// Function to create the server end of a client's named pipe. It is opened for overlapped
+// I/O, so that waiting for a reply can time out, with the event the I/O completes on.
+bool createClientPipe(const std::wstring& pipeName, ClientProcess& client) {
     client.pipeName = pipeName;
 
     // Create a named pipe
     client.hPipe = CreateNamedPipeW(
         pipeName.c_str(),
-        PIPE_ACCESS_DUPLEX,                      // Read/Write access
+        PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED, // Read/Write access, overlapped I/O
         PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT, // Message-type pipe
         1,                                       // Max instances
         512,                                     // Out buffer size
@@ -105,6 +103,23 @@ bool createClientProcess(const std::wstring& pipeName, const std::wstring& exePa
 
     if (client.hPipe == INVALID_HANDLE_VALUE) {
         std::wcerr << L"Failed to create named pipe: " << pipeName << L". GLE=" << GetLastError() << std::endl;
+        client.hPipe = NULL;
+        return false;
+    }
+
+    // Manual-reset, as overlapped I/O requires
+    client.hIoEvent = CreateEventW(NULL, TRUE, FALSE, NULL);
+    if (client.hIoEvent == NULL) {
+        std::wcerr << L"Failed to create I/O event for pipe: " << pipeName << L". GLE=" << GetLastError() << std::endl;
+        closeClientPipe(client);
+        return false;
+    }
+    return true;
+}
+
+// Function to create a named pipe, launch client process, and wait for connection
+bool createClientProcess(const std::wstring& pipeName, const std::wstring& exePath, ClientProcess& client) {
+    if (!createClientPipe(pipeName, client)) {
         return false;
     }
 
@@ -132,7 +147,7 @@ bool createClientProcess(const std::wstring& pipeName, const std::wstring& exePa
         &pi                     // Pointer to PROCESS_INFORMATION structure
     )) {
         std::wcerr << L"Failed to launch client process: " << exePath << L". GLE=" << GetLastError() << std::endl;
-        CloseHandle(client.hPipe);
+        closeClientPipe(client);
         return false;
     }
 
@@ -142,61 +157,574 @@ bool createClientProcess(const std::wstring& pipeName, const std::wstring& exePa
     std::wcout << L"Launched client process: " << exePath << L" with pipe: " << pipeName << std::endl;
 
     // Wait for the client to connect to the pipe
-    BOOL connected = ConnectNamedPipe(client.hPipe, NULL) ?
-        TRUE : (GetLastError() == ERROR_PIPE_CONNECTED);
+    OVERLAPPED overlapped = { 0 };
+    overlapped.hEvent = client.hIoEvent;
+    BOOL connected = ConnectNamedPipe(client.hPipe, &overlapped);
+    if (!connected) {
+        DWORD error = GetLastError();
+        DWORD unused;
+        connected = (error == ERROR_PIPE_CONNECTED) ||
+            (error == ERROR_IO_PENDING && GetOverlappedResult(client.hPipe, &overlapped, &unused, TRUE));
+    }
 
     if (!connected) {
         std::wcerr << L"Failed to connect to client on pipe: " << pipeName << L". GLE=" << GetLastError() << std::endl;
-        CloseHandle(client.hPipe);
+        closeClientPipe(client);
         CloseHandle(client.hProcess);
+        client.hProcess = NULL;
         return false;
     }
 
     std::wcout << L"Client connected on pipe: " << pipeName << std::endl;
+    setConnected(client, true);
     return true;
 }
 
-// Function to send the board state and receive a move from a client
-int getMove(HANDLE hPipe, TicTacToeBoard& board) {
-    // Prepare the board state as a string
-    std::wstringstream ss;
-    for (int i = 0; i < 9; ++i) {
-        ss << board[i];
+// Function to launch a client process in standby mode: it starts up and initializes right away,
+// then blocks until activateStandbyClient hands it an already connected pipe
+bool spawnStandbyClient(const std::wstring& exePath, StandbyClient& standby) {
+    standby.exePath = exePath;
+
+    // Control pipe: the child inherits the read end, the server keeps the write end
+    SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, TRUE };
+    HANDLE hControlRead = NULL;
+    if (!CreatePipe(&hControlRead, &standby.hControl, &sa, 0)) {
+        std::wcerr << L"Failed to create control pipe for: " << exePath << L". GLE=" << GetLastError() << std::endl;
+        standby.hControl = NULL;
+        return false;
+    }
+    SetHandleInformation(standby.hControl, HANDLE_FLAG_INHERIT, 0);
+
+    // Limit inheritance to this child's read end, so a client started at the same time on
+    // another thread cannot pick up this one's control pipe
+    SIZE_T attributeListSize = 0;
+    InitializeProcThreadAttributeList(NULL, 1, 0, &attributeListSize);
+    std::vector<char> attributeListBuffer(attributeListSize);
+    LPPROC_THREAD_ATTRIBUTE_LIST attributeList = reinterpret_cast<LPPROC_THREAD_ATTRIBUTE_LIST>(&attributeListBuffer[0]);
+    BOOL listReady = InitializeProcThreadAttributeList(attributeList, 1, 0, &attributeListSize);
+    if (!listReady || !UpdateProcThreadAttribute(attributeList, 0, PROC_THREAD_ATTRIBUTE_HANDLE_LIST,
+        &hControlRead, sizeof(hControlRead), NULL, NULL)) {
+        std::wcerr << L"Failed to set up handle inheritance for: " << exePath << L". GLE=" << GetLastError() << std::endl;
+        if (listReady) {
+            DeleteProcThreadAttributeList(attributeList);
+        }
+        CloseHandle(hControlRead);
+        CloseHandle(standby.hControl);
+        standby.hControl = NULL;
+        return false;
+    }
+
+    STARTUPINFOEXW si = { 0 };
+    PROCESS_INFORMATION pi = { 0 };
+    si.StartupInfo.cb = sizeof(si);
+    si.StartupInfo.dwFlags = STARTF_USESHOWWINDOW;
+    si.StartupInfo.wShowWindow = SW_HIDE; // The client shows its console once it is handed a game
+    si.lpAttributeList = attributeList;
+
+    // Prepare the command line: "bot1.exe --standby <control handle>"
+    std::wstring commandLine = exePath + L" --standby " +
+        std::to_wstring(reinterpret_cast<uintptr_t>(hControlRead));
+
+    BOOL created = CreateProcessW(
+        NULL,                   // No module name (use command line)
+        &commandLine[0],        // Command line
+        NULL,                   // Process handle not inheritable
+        NULL,                   // Thread handle not inheritable
+        TRUE,                   // Inherit the handles in the attribute list
+        CREATE_NEW_CONSOLE | EXTENDED_STARTUPINFO_PRESENT, // New console, si is a STARTUPINFOEX
+        NULL,                   // Use parent's environment block
+        NULL,                   // Use parent's starting directory
+        &si.StartupInfo,        // Pointer to STARTUPINFO structure
+        &pi                     // Pointer to PROCESS_INFORMATION structure
+    );
+    DeleteProcThreadAttributeList(attributeList);
+    CloseHandle(hControlRead); // Only the child needs it now
+
+    if (!created) {
+        std::wcerr << L"Failed to launch client process: " << exePath << L". GLE=" << GetLastError() << std::endl;
+        CloseHandle(standby.hControl);
+        standby.hControl = NULL;
+        return false;
+    }
+
+    standby.hProcess = pi.hProcess;
+    CloseHandle(pi.hThread); // We don't need the thread handle
+
+    std::wcout << L"Launched standby client process: " << exePath << std::endl;
+    return true;
+}
+
+// Function to connect a standby client: the server opens both ends of the pipe itself and
+// duplicates the client end into the standby process, so nobody waits on ConnectNamedPipe
+bool activateStandbyClient(StandbyClient& standby, const std::wstring& pipeName, ClientProcess& client) {
+    client.hProcess = standby.hProcess;
+    standby.hProcess = NULL;
+
+    if (!createClientPipe(pipeName, client)) {
+        CloseHandle(standby.hControl);
+        standby.hControl = NULL;
+        return false;
+    }
+
+    HANDLE hClientEnd = CreateFileW(pipeName.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    HANDLE hRemote = NULL;
+    if (hClientEnd == INVALID_HANDLE_VALUE ||
+        !DuplicateHandle(GetCurrentProcess(), hClientEnd, client.hProcess, &hRemote, 0, FALSE,
+            DUPLICATE_SAME_ACCESS | DUPLICATE_CLOSE_SOURCE)) {
+        std::wcerr << L"Failed to hand pipe to client: " << pipeName << L". GLE=" << GetLastError() << std::endl;
+        closeClientPipe(client);
+        CloseHandle(standby.hControl);
+        standby.hControl = NULL;
+        return false;
     }
-    ss << std::endl;  // Ensure there's a newline character
-    std::wstring boardState = ss.str();
 
-    // Write the board state to the process's pipe
+    // Tell the client which handle value its connection has in its own process
+    std::wstring handleValue = std::to_wstring(reinterpret_cast<uintptr_t>(hRemote)) + L"\n";
     DWORD bytesWritten;
-    if (!WriteFile(hPipe, boardState.c_str(), static_cast<DWORD>(boardState.size() * sizeof(wchar_t)), &bytesWritten, NULL)) {
-        std::wcerr << L"Failed to write to process pipe. GLE=" << GetLastError() << std::endl;
-        return -1;
+    BOOL sent = WriteFile(standby.hControl, handleValue.c_str(),
+        static_cast<DWORD>(handleValue.size() * sizeof(wchar_t)), &bytesWritten, NULL);
+    CloseHandle(standby.hControl);
+    standby.hControl = NULL;
+
+    if (!sent) {
+        std::wcerr << L"Failed to write to control pipe for: " << standby.exePath << L". GLE=" << GetLastError() << std::endl;
+        closeClientPipe(client);
+        return false;
     }
 
-    // Read the move from the process's pipe
-    wchar_t moveBuffer[256];
-    DWORD bytesRead;
-    if (!ReadFile(hPipe, moveBuffer, sizeof(moveBuffer) - sizeof(wchar_t), &bytesRead, NULL) || bytesRead == 0) {
-        std::wcerr << L"Failed to read from process pipe. GLE=" << GetLastError() << std::endl;
-        return -1;
+    std::wcout << L"Client " << standby.exePath << L" connected on pipe: " << pipeName << std::endl;
+    setConnected(client, true);
+    return true;
+}
+
+// Function to end a standby client that was never activated
+void discardStandbyClient(StandbyClient& standby) {
+    if (standby.hProcess != NULL) {
+        TerminateProcess(standby.hProcess, 0);
+        CloseHandle(standby.hProcess);
+        standby.hProcess = NULL;
+    }
+    if (standby.hControl != NULL) {
+        CloseHandle(standby.hControl);
+        standby.hControl = NULL;
     }
-    moveBuffer[bytesRead / sizeof(wchar_t)] = L'\0';
+}
 
-    int move = _wtoi(moveBuffer);
-    return move;
+// StandbyPool Class Definition: client processes started ahead of time, so a game takes an
+// already initialized process instead of paying for process creation and runtime start-up
+// before its first move.
+class StandbyPool {
+public:
+    // refill: replace every client taken from the pool in the background, for a pool that
+    // serves more than one game. Otherwise the pool only holds what fill started.
+    explicit StandbyPool(bool refill = false) : refill(refill) {
+    }
+
+    // Start count standby processes of exePath
+    void fill(const std::wstring& exePath, int count) {
+        for (int i = 0; i < count; ++i) {
+            StandbyClient standby;
+            if (spawnStandbyClient(exePath, standby)) {
+                std::lock_guard<std::mutex> lock(mutex);
+                ready.push_back(standby);
+            }
+        }
+    }
+
+    // Take a standby process of exePath, starting one now if none is ready
+    bool take(const std::wstring& exePath, StandbyClient& standby) {
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (size_t i = 0; i < ready.size(); ++i) {
+                if (ready[i].exePath == exePath) {
+                    standby = ready[i];
+                    ready.erase(ready.begin() + i);
+                    found = true;
+                    break;
+                }
+            }
+        }
+        if (!found) {
+            return spawnStandbyClient(exePath, standby);
+        }
+        if (refill) {
+            refills.emplace_back([this, exePath]() { fill(exePath, 1); });
+        }
+        return true;
+    }
+
+    // Wait for the refills and end the standby processes nobody took
+    void drain() {
+        for (std::thread& refill : refills) {
+            refill.join();
+        }
+        refills.clear();
+
+        std::lock_guard<std::mutex> lock(mutex);
+        for (StandbyClient& standby : ready) {
+            discardStandbyClient(standby);
+        }
+        ready.clear();
+    }
+
+private:
+    bool refill;
+    std::mutex mutex;                  // Guards ready against the refill threads
+    std::vector<StandbyClient> ready;
+    std::vector<std::thread> refills;  // Only touched by the thread calling take/drain
+};
+
+// Clients for the game, started while the players are still choosing its settings. The
+// server plays one game per run, so clients taken are not replaced.
+static StandbyPool standbyPool;
+
+// What a Channel's exchange returns instead of a reply length when it gets no reply
+const int kExchangeFailed = -1;     // The client is gone
+const int kExchangeTimedOut = -2;   // The client did not answer within its move timeout
+
+// Function to wait for an overlapped read or write on a client's pipe to complete within the
+// client's move timeout. started is what ReadFile/WriteFile returned. Returns the number of
+// bytes transferred, kExchangeFailed or kExchangeTimedOut.
+int finishPipeIo(ClientProcess& client, OVERLAPPED& overlapped, BOOL started) {
+    if (!started && GetLastError() != ERROR_IO_PENDING) {
+        return kExchangeFailed;
+    }
+    DWORD bytes = 0;
+    if (WaitForSingleObject(overlapped.hEvent, client.moveTimeoutMs) != WAIT_OBJECT_0) {
+        // Cancel the operation and wait until it no longer uses overlapped and the buffer
+        CancelIoEx(client.hPipe, &overlapped);
+        GetOverlappedResult(client.hPipe, &overlapped, &bytes, TRUE);
+        return kExchangeTimedOut;
+    }
+    if (!GetOverlappedResult(client.hPipe, &overlapped, &bytes, FALSE)) {
+        return kExchangeFailed;
+    }
+    return static_cast<int>(bytes);
 }
 
-// Function to play the TicTacToe game based on the selected mode
-void playGame(int mode) {
-    TicTacToeBoard board;
+// How getMove talks to a client in a real game: over the client's named pipe
+struct PipeChannel {
+    // Send message to the client and wait for its reply. Returns the reply's length,
+    // kExchangeFailed if the client is gone, kExchangeTimedOut if it did not answer in time.
+    template <typename Board>
+    static int exchange(ClientProcess& client, const Board&, const wchar_t* message, int length,
+        wchar_t* reply, int replySize) {
+        OVERLAPPED overlapped = { 0 };
+        overlapped.hEvent = client.hIoEvent;
+
+        // Write the update to the process's pipe
+        BOOL started = WriteFile(client.hPipe, message, static_cast<DWORD>(length * sizeof(wchar_t)), NULL, &overlapped);
+        int bytesWritten = finishPipeIo(client, overlapped, started);
+        if (bytesWritten < 0) {
+            if (bytesWritten == kExchangeFailed) {
+                std::wcerr << L"Failed to write to process pipe. GLE=" << GetLastError() << std::endl;
+            }
+            return bytesWritten;
+        }
+
+        // Read the move from the process's pipe
+        started = ReadFile(client.hPipe, reply, static_cast<DWORD>((replySize - 1) * sizeof(wchar_t)), NULL, &overlapped);
+        int bytesRead = finishPipeIo(client, overlapped, started);
+        if (bytesRead <= 0) {
+            if (bytesRead != kExchangeTimedOut) {
+                std::wcerr << L"Failed to read from process pipe. GLE=" << GetLastError() << std::endl;
+                return kExchangeFailed;
+            }
+            return kExchangeTimedOut;
+        }
+        int replyLength = bytesRead / static_cast<int>(sizeof(wchar_t));
+        reply[replyLength] = L'\0';
+        return replyLength;
+    }
+};
+
+// Stand-in for a client's pipe in the local checks and benchmarks: answers every update with
+// the first legal move on the server's board, as a bot would, without any I/O
+struct LocalChannel {
+    template <typename Board>
+    static int exchange(ClientProcess&, const Board& board, const wchar_t*, int, wchar_t* reply, int replySize) {
+        int pos = 0;
+        while (pos < Board::kCellCount - 1 && !board.isLegal(pos)) {
+            pos++;
+        }
+        return swprintf(reply, replySize, L"%d\n", pos);
+    }
+};
+
+// Function to send a board update and receive a move from a client over Channel.
+// A client that has already been synced only gets the last accepted move (lastPos) and the
+// sequence number (moves on the board); an unchanged sequence number means its own previous
+// move was rejected. The full board is resent only when the client answers with a resync
+// request ("R"), and a client that is still out of sync after kMaxResyncs full boards is
+// given up on. Returns false if the client failed; otherwise move receives whatever move the
+// client sent, which the caller validates.
+template <typename Channel, typename Board>
+bool getMove(ClientProcess& client, const Board& board, int seq, int lastPos, char player, int& move) {
+    wchar_t message[kMessageSize];
+    int length;
+    int resyncs = 0;
+    if (client.syncedSeq < 0) {
+        length = formatFullSync(message, board, seq, lastPos, player);
+    }
+    else {
+        // Counted per client: a player is only asked to move on every other sequence number
+        client.deltasSent++;
+        length = formatDelta(message, board, seq, lastPos, client.deltasSent % kChecksumInterval == 0);
+    }
+
+    while (true) {
+        unsigned long long start = metrics.isEnabled() ? clockTicks() : 0;
+
+        wchar_t moveBuffer[256];
+        int replyLength = Channel::exchange(client, board, message, length, moveBuffer, 256);
+        if (replyLength == kExchangeTimedOut) {
+            std::wcerr << L"Client on pipe " << client.pipeName << L" did not answer within "
+                << client.moveTimeoutMs << L" ms." << std::endl;
+            metrics.increment(kTimeouts);
+            setConnected(client, false);
+            return false;
+        }
+        if (replyLength < 0) {
+            metrics.increment(kClientErrors);
+            setConnected(client, false);
+            return false;
+        }
+        client.syncedSeq = seq;
+        if (metrics.isEnabled()) {
+            metrics.observeLatency(client.metricsSlot, clockTicks() - start);
+        }
+
+        if (moveBuffer[0] == L'R') {
+            if (resyncs == kMaxResyncs) {
+                std::wcerr << L"Client on pipe " << client.pipeName << L" is still out of sync after a full board." << std::endl;
+                metrics.increment(kClientErrors);
+                setConnected(client, false);
+                return false;
+            }
+            resyncs++;
+            std::wcout << L"Client on pipe " << client.pipeName << L" requested a resync." << std::endl;
+            metrics.increment(kResyncs);
+            length = formatFullSync(message, board, seq, lastPos, player);
+            continue;
+        }
+
+        move = _wtoi(moveBuffer);
+        return true;
+    }
+}
+
+// Function to create the shared memory spectators read the live game from. Returns NULL if
+// it cannot, or if another process already publishes to it.
+SpectatorFeed* openSpectatorFeed(HANDLE& hMapping) {
+    hMapping = CreateFileMappingW(
+        INVALID_HANDLE_VALUE,   // Backed by the paging file
+        NULL,                   // Default security attributes
+        PAGE_READWRITE,
+        0,
+        sizeof(SpectatorFeed),
+        kSpectatorMappingName
+    );
+    if (hMapping == NULL) {
+        std::wcerr << L"Failed to create spectator feed. GLE=" << GetLastError() << std::endl;
+        return NULL;
+    }
+    if (GetLastError() == ERROR_ALREADY_EXISTS) {
+        // The seqlock allows a single writer: leave the feed to whoever created it
+        std::wcerr << L"Spectator feed already exists, not publishing this game." << std::endl;
+        CloseHandle(hMapping);
+        hMapping = NULL;
+        return NULL;
+    }
+
+    SpectatorFeed* feed = static_cast<SpectatorFeed*>(MapViewOfFile(hMapping, FILE_MAP_ALL_ACCESS, 0, 0, sizeof(SpectatorFeed)));
+    if (feed == NULL) {
+        std::wcerr << L"Failed to map spectator feed. GLE=" << GetLastError() << std::endl;
+        CloseHandle(hMapping);
+        hMapping = NULL;
+    }
+    return feed;
+}
+
+// Function to clear the spectator state for a new game
+void resetSpectatorState(SpectatorState& state, int cellCount) {
+    state.cellCount = cellCount;
+    state.moveCount = 0;
+    memset(state.board, ' ', sizeof(state.board));
+    state.currentPlayer = 'X';
+    state.winner = ' ';
+    state.gameOver = false;
+    state.aborted = false;
+}
+
+// Function to add an accepted move to the spectator state
+void recordSpectatorMove(SpectatorState& state, int pos, char player, char winner, bool gameOver) {
+    state.board[pos] = player;
+    state.moves[state.moveCount++] = static_cast<signed char>(pos);
+    state.currentPlayer = (player == 'X') ? 'O' : 'X';
+    state.winner = winner;
+    state.gameOver = gameOver;
+}
+
+// Structure to hold the state of one game, shared by the game loop and the local checks
+template <typename Board>
+struct GameState {
+    Board board;
     int moveCount = 0;
+    int lastPos = -1;          // Last accepted move, sent to the next player
     char currentPlayer = 'X';
+    char winner = ' ';
+    bool gameOver = false;     // Set once someone has won or the board is full
+    SpectatorState spectatorState;
+    SpectatorFeed* spectatorFeed = NULL; // Shared memory spectators read, NULL if unavailable
+};
+
+// Outcome of one turn of the game loop
+enum TurnResult {
+    kMoveAccepted,
+    kMoveRejected,     // Illegal move, the same player is asked again
+    kClientFailed      // The client's pipe failed, the game cannot go on
+};
+
+// Function to set up a new game between client1 (X) and client2 (O)
+template <typename Board>
+void startGame(GameState<Board>& game, ClientProcess& client1, ClientProcess& client2) {
+    game.board.reset();
+    game.moveCount = 0;
+    game.lastPos = -1;
+    game.currentPlayer = 'X';
+    game.winner = ' ';
+    game.gameOver = false;
 
+    // Each player gets a full sync on its first turn
+    client1.syncedSeq = -1;
+    client1.deltasSent = 0;
+    client2.syncedSeq = -1;
+    client2.deltasSent = 0;
+
+    resetSpectatorState(game.spectatorState, Board::kCellCount);
+    if (game.spectatorFeed != NULL) {
+        publishSpectatorState(game.spectatorFeed, game.spectatorState);
+    }
+
+    metrics.increment(kGamesStarted);
+    metrics.addToGauge(kActiveGames, 1);
+}
+
+// Function to play one turn: get the current player's move from its client over Channel,
+// make it if it is legal, and update the metrics and the spectator feed. pos receives the
+// move the client sent.
+template <typename Channel, typename Board>
+TurnResult playTurn(GameState<Board>& game, ClientProcess& client, int& pos) {
+    if (!getMove<Channel>(client, game.board, game.moveCount, game.lastPos, game.currentPlayer, pos)) {
+        return kClientFailed;
+    }
+
+    // Validate and make the move. Anything else, including the -1 a human client sends for
+    // input it could not read, is rejected and the same player is asked again.
+    if (pos < 0 || pos >= Board::kCellCount || !game.board.makeMove(pos, game.currentPlayer)) {
+        metrics.increment(kInvalidMoves);
+        return kMoveRejected;
+    }
+
+    game.moveCount++;
+    game.lastPos = pos;
+    metrics.increment(kMovesTotal);
+
+    // Check for a winner or draw
+    game.winner = game.board.checkWinner();
+    game.gameOver = (game.winner != ' ' || game.board.isFull());
+
+    recordSpectatorMove(game.spectatorState, pos, game.currentPlayer, game.winner, game.gameOver);
+    if (game.spectatorFeed != NULL) {
+        publishSpectatorState(game.spectatorFeed, game.spectatorState);
+    }
+
+    // Toggle player
+    if (!game.gameOver) {
+        game.currentPlayer = (game.currentPlayer == 'X') ? 'O' : 'X';
+    }
+    return kMoveAccepted;
+}
+
+// Function to record the end of a game, finished or left because a client failed
+template <typename Board>
+void endGame(GameState<Board>& game) {
+    metrics.increment(game.gameOver ? kGamesFinished : kGamesAborted);
+    metrics.addToGauge(kActiveGames, -1);
+
+    // Spectators wait for gameOver, so an aborted game must be published as over as well
+    if (!game.gameOver) {
+        game.spectatorState.gameOver = true;
+        game.spectatorState.aborted = true;
+        if (game.spectatorFeed != NULL) {
+            publishSpectatorState(game.spectatorFeed, game.spectatorState);
+        }
+    }
+}
+
+// Minimax scores of classic positions (1: X wins, -1: O wins, 0: draw), keyed by the
+// canonical hash so all 8 rotations and reflections of a position share one entry
+static PositionCache<signed char> classicScores;
+
+// Function to score a classic position with best play from both sides, player to move
+int classicScore(TicTacToeBoard& board, char player) {
+    const signed char* cached = classicScores.find(board.getCanonicalHash());
+    if (cached != NULL) {
+        return *cached;
+    }
+
+    int score;
+    char winner = board.checkWinner();
+    if (winner != ' ') {
+        score = (winner == 'X') ? 1 : -1;
+    }
+    else if (board.isFull()) {
+        score = 0;
+    }
+    else {
+        char opponent = (player == 'X') ? 'O' : 'X';
+        score = (player == 'X') ? -1 : 1; // Worst case for player
+        for (int pos = 0; pos < TicTacToeBoard::kCellCount; ++pos) {
+            if (board.makeMove(pos, player)) {
+                int moveScore = classicScore(board, opponent);
+                board.undoMove(pos);
+                if ((player == 'X') ? moveScore > score : moveScore < score) {
+                    score = moveScore;
+                }
+            }
+        }
+    }
+    classicScores.store(board.getCanonicalHash(), static_cast<signed char>(score));
+    return score;
+}
+
+// Function to show on the server console how the game ends with best play from here
+void displayOutlook(const TicTacToeBoard& board, char player) {
+    TicTacToeBoard position = board; // Searched with make/undo, the game's board stays as it is
+    int score = classicScore(position, player);
+    std::wcout << L"With best play: " << (score > 0 ? L"X wins" : (score < 0 ? L"O wins" : L"draw")) << std::endl;
+}
+
+// The ultimate board is too large to search to the end, so it gets no outlook
+void displayOutlook(const UltimateBoard&, char) {
+}
+
+// Function to play the TicTacToe game based on the selected mode, on a
+// TicTacToeBoard (classic) or an UltimateBoard
+template <typename Board>
+void playGame(int mode) {
     // Structures to hold client information
     ClientProcess human1Client; // Player 1
     ClientProcess human2Client; // Player 2
     ClientProcess bot1Client;   // Bot1
     ClientProcess bot2Client;   // Bot2 (only in Bot vs Bot mode)
+    human1Client.metricsSlot = kSlotHuman1;
+    human2Client.metricsSlot = kSlotHuman2;
+    human1Client.moveTimeoutMs = kHumanMoveTimeoutMs;
+    human2Client.moveTimeoutMs = kHumanMoveTimeoutMs;
+    bot1Client.metricsSlot = kSlotBot1;
+    bot2Client.metricsSlot = kSlotBot2;
 
     // Define pipe names
     std::wstring pipeNameHuman1 = L"\\\\.\\pipe\\TicTacToeHuman1";
@@ -205,195 +733,435 @@ void playGame(int mode) {
     std::wstring pipeNameBot2 = L"\\\\.\\pipe\\TicTacToeBot2";
 
     // Paths to client executables
-    std::wstring humanExePath = L"human.exe"; // Ensure human.exe exists in the same directory
-    std::wstring bot1ExePath = L"bot1.exe";  // Ensure bot1.exe exists in the same directory
-    std::wstring bot2ExePath = L"bot2.exe";  // Ensure bot2.exe exists in the same directory
+    std::wstring humanExePath = kHumanExePath;
+    std::wstring bot1ExePath = kBot1ExePath;
+    std::wstring bot2ExePath = kBot2ExePath;
+
+    // Initialize clients based on game mode. Both processes come from the standby pool,
+    // already initialized, and are each handed their connection.
+    std::wstring exePath1;
+    std::wstring exePath2;
+    std::wstring pipeName1;
+    std::wstring pipeName2;
+    std::wstring name1;            // Shown on the console
+    std::wstring name2;
+    ClientProcess* client1 = NULL; // Player X
+    ClientProcess* client2 = NULL; // Player O
 
-    // Initialize clients based on game mode
     if (mode == 1) { // Human vs Human
         std::wcout << L"Human vs Human mode selected. Launching two human processes." << std::endl;
-        // Create and launch human1 process
-        if (!createClientProcess(pipeNameHuman1, humanExePath, human1Client)) {
-            std::wcerr << L"Failed to set up Human1." << std::endl;
-            return;
-        }
-        // Create and launch human2 process
-        if (!createClientProcess(pipeNameHuman2, humanExePath, human2Client)) {
-            std::wcerr << L"Failed to set up Human2." << std::endl;
-            return;
-        }
+        exePath1 = humanExePath;
+        pipeName1 = pipeNameHuman1;
+        name1 = L"Human1";
+        client1 = &human1Client;
+        exePath2 = humanExePath;
+        pipeName2 = pipeNameHuman2;
+        name2 = L"Human2";
+        client2 = &human2Client;
     }
     else if (mode == 2) { // Human vs Bot
         std::wcout << L"Human vs Bot mode selected. Launching one human and one bot process." << std::endl;
-        // Create and launch human1 process
-        if (!createClientProcess(pipeNameHuman1, humanExePath, human1Client)) {
-            std::wcerr << L"Failed to set up Human1." << std::endl;
-            return;
-        }
-        // Create and launch bot1 process
-        if (!createClientProcess(pipeNameBot1, bot1ExePath, bot1Client)) {
-            std::wcerr << L"Failed to set up Bot1." << std::endl;
-            return;
-        }
+        exePath1 = humanExePath;
+        pipeName1 = pipeNameHuman1;
+        name1 = L"Human1";
+        client1 = &human1Client;
+        exePath2 = bot1ExePath;
+        pipeName2 = pipeNameBot1;
+        name2 = L"Bot1";
+        client2 = &bot1Client;
     }
     else if (mode == 3) { // Bot vs Bot
         std::wcout << L"Bot vs Bot mode selected. Launching two bot processes." << std::endl;
-        // Create and launch bot1 process
-        if (!createClientProcess(pipeNameBot1, bot1ExePath, bot1Client)) {
-            std::wcerr << L"Failed to set up Bot1." << std::endl;
-            return;
-        }
-        // Create and launch bot2 process
-        if (!createClientProcess(pipeNameBot2, bot2ExePath, bot2Client)) {
-            std::wcerr << L"Failed to set up Bot2." << std::endl;
-            return;
-        }
+        exePath1 = bot1ExePath;
+        pipeName1 = pipeNameBot1;
+        name1 = L"Bot1";
+        client1 = &bot1Client;
+        exePath2 = bot2ExePath;
+        pipeName2 = pipeNameBot2;
+        name2 = L"Bot2";
+        client2 = &bot2Client;
+    }
+
+    StandbyClient standby1;
+    StandbyClient standby2;
+    if (!standbyPool.take(exePath1, standby1) || !standbyPool.take(exePath2, standby2) ||
+        !activateStandbyClient(standby1, pipeName1, *client1) ||
+        !activateStandbyClient(standby2, pipeName2, *client2)) {
+        std::wcerr << L"Failed to set up clients." << std::endl;
+        discardStandbyClient(standby1);
+        discardStandbyClient(standby2);
+        closeClient(*client1);
+        closeClient(*client2);
+        return;
     }
 
+    // The game, published into shared memory for spectators after every move
+    GameState<Board> game;
+    HANDLE hSpectatorMapping = NULL;
+    game.spectatorFeed = openSpectatorFeed(hSpectatorMapping);
+
+    startGame(game, *client1, *client2);
+
     // Game loop
     while (true) {
-        board.display();
+        game.board.display();
+        displayOutlook(game.board, game.currentPlayer);
+        char player = game.currentPlayer;
+        const std::wstring& name = (player == 'X') ? name1 : name2;
+
         int pos = -1;
+        TurnResult result = playTurn<PipeChannel>(game, (player == 'X') ? *client1 : *client2, pos);
+        if (result == kClientFailed) {
+            std::wcerr << name << L" failed to provide a move." << std::endl;
+            break;
+        }
+        std::wcout << name << L" (" << player << L") chose move: " << pos << std::endl;
 
-        if (mode == 1) { // Human vs Human
-            if (currentPlayer == 'X') {
-                pos = getMove(human1Client.hPipe, board);
-                if (pos == -1) {
-                    std::wcerr << L"Human1 failed to provide a move." << std::endl;
-                    break;
-                }
-                std::wcout << L"Human1 (X) chose move: " << pos << std::endl;
+        if (result == kMoveRejected) {
+            if (pos < 0 || pos >= Board::kCellCount) {
+                std::wcerr << L"Invalid move input: " << pos << std::endl;
             }
-            else { // Player O
-                pos = getMove(human2Client.hPipe, board);
-                if (pos == -1) {
-                    std::wcerr << L"Human2 failed to provide a move." << std::endl;
-                    break;
-                }
-                std::wcout << L"Human2 (O) chose move: " << pos << std::endl;
+            else {
+                std::wcerr << L"Invalid move. Cell already occupied or out of range." << std::endl;
             }
+            continue; // Skip invalid move
         }
-        else if (mode == 2) { // Human vs Bot
-            if (currentPlayer == 'X') { // Human's turn
-                pos = getMove(human1Client.hPipe, board);
-                if (pos == -1) {
-                    std::wcerr << L"Human1 failed to provide a move." << std::endl;
-                    break;
-                }
-                std::wcout << L"Human1 (X) chose move: " << pos << std::endl;
+
+        if (game.gameOver) {
+            game.board.display();
+            if (game.winner != ' ') {
+                std::wcout << L"Winner: " << game.winner << std::endl;
             }
-            else { // Bot's turn
-                pos = getMove(bot1Client.hPipe, board);
-                if (pos == -1) {
-                    std::wcerr << L"Bot1 failed to provide a move." << std::endl;
-                    break;
-                }
-                std::wcout << L"Bot1 (O) chose move: " << pos << std::endl;
+            else {
+                std::wcout << L"It's a draw!" << std::endl;
             }
+            break;
         }
-        else if (mode == 3) { // Bot vs Bot
-            if (currentPlayer == 'X') { // Bot1's turn
-                pos = getMove(bot1Client.hPipe, board);
-                if (pos == -1) {
-                    std::wcerr << L"Bot1 failed to provide a move." << std::endl;
-                    break;
-                }
-                std::wcout << L"Bot1 (X) chose move: " << pos << std::endl;
+    }
+
+    endGame(game);
+
+    // Terminate and clean up client processes after the game ends
+    closeClient(*client1);
+    closeClient(*client2);
+
+    // Wait for user input before exiting
+    std::wcout << L"Press Enter to exit...";
+    std::wcin.get();
+
+    if (game.spectatorFeed != NULL) {
+        UnmapViewOfFile(game.spectatorFeed);
+        CloseHandle(hSpectatorMapping);
+    }
+}
+
+// Function to measure time-to-first-move of a new bot: a cold launch that connects by pipe
+// name (createClientProcess) versus taking a process from the standby pool, as playGame does
+void runStartupBenchmark(int iterations) {
+    std::wstring exePath = kBot1ExePath;
+    std::wstring pipeName = L"\\\\.\\pipe\\TicTacToeStartupBenchmark";
+
+    // The pool starts one process up front and replaces each one taken in the background.
+    // The cold launch between two takes gives the replacement time to start up, as the
+    // players choosing the game settings do for playGame.
+    StandbyPool pool(true);
+    pool.fill(exePath, 1);
+
+    double coldTotalMs = 0.0;
+    double warmTotalMs = 0.0;
+    int coldRuns = 0;
+    int warmRuns = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        unsigned long long start;
+
+        // Cold: new process, which then polls for the named pipe
+        {
+            TicTacToeBoard board;
+            ClientProcess client;
+            start = clockTicks();
+            int move;
+            if (createClientProcess(pipeName, exePath, client) && getMove<PipeChannel>(client, board, 0, -1, 'X', move)) {
+                coldTotalMs += ticksToMillis(clockTicks() - start);
+                coldRuns++;
             }
-            else { // Bot2's turn
-                pos = getMove(bot2Client.hPipe, board);
-                if (pos == -1) {
-                    std::wcerr << L"Bot2 failed to provide a move." << std::endl;
-                    break;
-                }
-                std::wcout << L"Bot2 (O) chose move: " << pos << std::endl;
+            closeClient(client);
+        }
+
+        // Pooled: standby process that is handed a connected pipe
+        {
+            TicTacToeBoard board;
+            StandbyClient standby;
+            ClientProcess client;
+            int move;
+            start = clockTicks();
+            if (pool.take(exePath, standby) && activateStandbyClient(standby, pipeName, client) &&
+                getMove<PipeChannel>(client, board, 0, -1, 'X', move)) {
+                warmTotalMs += ticksToMillis(clockTicks() - start);
+                warmRuns++;
             }
+            closeClient(client);
         }
+    }
+    pool.drain();
+
+    std::wcout << L"Time to first move over " << iterations << L" launches:" << std::endl;
+    if (coldRuns > 0) {
+        std::wcout << L"  Cold launch:    " << coldTotalMs / coldRuns << L" ms" << std::endl;
+    }
+    if (warmRuns > 0) {
+        std::wcout << L"  Standby pool:   " << warmTotalMs / warmRuns << L" ms" << std::endl;
+    }
+}
+
+// Function to count the positions reachable in exactly depth moves (perft)
+unsigned long long perft(UltimateBoard& board, int depth, char player) {
+    char opponent = (player == 'X') ? 'O' : 'X';
+    unsigned long long nodes = 0;
+    unsigned int playable = board.playableSubBoards();
 
-        // Validate the move
-        if (pos < 0 || pos > 8) {
-            std::wcerr << L"Invalid move input: " << pos << std::endl;
-            if (mode == 1 || mode == 2 || mode == 3) {
-                continue; // Skip invalid move
+    for (int sub = 0; sub < 9; ++sub) {
+        if (!(playable & (1u << sub))) {
+            continue;
+        }
+        unsigned int moves = board.subBoardMoves(sub);
+        if (depth == 1) {
+            // Count the leaves without making the moves
+            for (; moves != 0; moves &= moves - 1) {
+                nodes++;
             }
+            continue;
+        }
+        for (; moves != 0; moves &= moves - 1) {
+            unsigned long pos;
+            _BitScanForward(&pos, moves);
+            board.makeMove(sub * 9 + static_cast<int>(pos), player);
+            nodes += perft(board, depth - 1, opponent);
+            board.undoMove();
+        }
+    }
+    return nodes;
+}
+
+// Function to measure move generation and make/undo throughput of the ultimate board
+void runPerftBenchmark(int maxDepth) {
+    UltimateBoard board;
+    for (int depth = 1; depth <= maxDepth; ++depth) {
+        unsigned long long start = clockTicks();
+        unsigned long long nodes = perft(board, depth, 'X');
+        double ms = ticksToMillis(clockTicks() - start);
+        std::wcout << L"perft(" << depth << L") = " << nodes << L" in " << ms << L" ms";
+        if (ms > 0.0) {
+            std::wcout << L" (" << nodes / ms / 1000.0 << L" Mnodes/s)";
         }
+        std::wcout << std::endl;
+    }
+}
+
+// Function to play games through playTurn with both clients' pipes replaced by LocalChannel,
+// so everything but the pipe I/O runs as in a real game. Returns the number of moves played.
+template <typename Board>
+unsigned long long playLocalGames(int games, SpectatorFeed* spectatorFeed) {
+    GameState<Board> game;
+    game.spectatorFeed = spectatorFeed;
+    ClientProcess client1;
+    ClientProcess client2;
+    unsigned long long moves = 0;
 
-        // Attempt to make the move
-        if (!board.makeMove(pos, currentPlayer)) {
-            std::wcerr << L"Invalid move. Cell already occupied or out of range." << std::endl;
-            if (mode == 1 || mode == 2 || mode == 3) {
-                continue; // Skip invalid move
+    for (int i = 0; i < games; ++i) {
+        startGame(game, client1, client2);
+        while (!game.gameOver) {
+            int pos;
+            if (playTurn<LocalChannel>(game, (game.currentPlayer == 'X') ? client1 : client2, pos) == kMoveAccepted) {
+                moves++;
             }
         }
+        endGame(game);
+    }
+    return moves;
+}
+
+// Function to publish local games of both rulesets to the spectator feed back to back for a
+// while, so spectator.exe --load-test has a writer updating the feed as fast as it can.
+// Fails if the feed cannot be created or another process already publishes to it.
+int runSpectatorWriter(int seconds) {
+    HANDLE hMapping = NULL;
+    SpectatorFeed* feed = openSpectatorFeed(hMapping);
+    if (feed == NULL) {
+        return 1;
+    }
+
+    unsigned long long games = 0;
+    unsigned long long moves = 0;
+    ULONGLONG end = GetTickCount64() + static_cast<ULONGLONG>(seconds) * 1000;
+    while (GetTickCount64() < end) {
+        moves += playLocalGames<TicTacToeBoard>(100, feed);
+        moves += playLocalGames<UltimateBoard>(100, feed);
+        games += 200;
+    }
+
+    // Every game publishes its empty board and then every move
+    std::wcout << L"Published " << games + moves << L" updates (" << games << L" games) in "
+        << seconds << L" s" << std::endl;
+
+    UnmapViewOfFile(feed);
+    CloseHandle(hMapping);
+    return 0;
+}
+
+#ifdef TTT_ALLOCATION_CHECK
+// Function to count the heap allocations of the steady-state path after a warm-up game
+template <typename Board>
+unsigned long countGameLoopAllocations(int games) {
+    static SpectatorFeed feed; // Zero-initialized, stands in for the shared memory
+    playLocalGames<Board>(1, &feed);
+    armAllocationCounter();
+    playLocalGames<Board>(games, &feed);
+    return disarmAllocationCounter();
+}
+
+// Function to fail if the steady-state move path allocates on either ruleset
+int runAllocationCheck(int games) {
+    unsigned long classic = countGameLoopAllocations<TicTacToeBoard>(games);
+    unsigned long ultimate = countGameLoopAllocations<UltimateBoard>(games);
+    std::wcout << L"Heap allocations after warm-up over " << games << L" games:" << std::endl;
+    std::wcout << L"  Classic:  " << classic << std::endl;
+    std::wcout << L"  Ultimate: " << ultimate << std::endl;
+    return (classic == 0 && ultimate == 0) ? 0 : 1;
+}
+#endif
 
-        moveCount++;
+// Function to play games between two connected clients through playTurn, as playGame does
+// without the console output. Returns the number of moves played, -1 if a client failed.
+template <typename Board>
+long long playPipeGames(int games, ClientProcess& client1, ClientProcess& client2) {
+    GameState<Board> game;
+    long long moves = 0;
 
-        // Check for a winner or draw
-        char winner = board.checkWinner();
-        if (winner != ' ' || board.isFull()) {
-            board.display();
-            if (winner != ' ') {
-                std::wcout << L"Winner: " << winner << std::endl;
+    for (int i = 0; i < games; ++i) {
+        startGame(game, client1, client2);
+        while (!game.gameOver) {
+            int pos;
+            TurnResult result = playTurn<PipeChannel>(game, (game.currentPlayer == 'X') ? client1 : client2, pos);
+            if (result == kClientFailed) {
+                endGame(game);
+                return -1;
             }
-            else {
-                std::wcout << L"It's a draw!" << std::endl;
+            if (result == kMoveAccepted) {
+                moves++;
             }
-            break;
         }
+        endGame(game);
+    }
+    return moves;
+}
 
-        // Toggle player
-        currentPlayer = (currentPlayer == 'X') ? 'O' : 'X';
+// Function to measure what recording metrics adds to the real move path: games between two
+// bot processes over their pipes, with metrics switched off and on game by game so changes
+// in the machine's load affect both sides alike. Returns false if a bot failed.
+template <typename Board>
+bool reportMetricsOverhead(const wchar_t* name, int games, ClientProcess& client1, ClientProcess& client2) {
+    if (playPipeGames<Board>(games / 10 + 1, client1, client2) < 0) { // Warm-up
+        return false;
     }
 
-    // Terminate and clean up client processes after the game ends
-    if (mode == 1) { // Human vs Human
-        if (human1Client.hProcess != NULL) {
-            TerminateProcess(human1Client.hProcess, 0);
-            CloseHandle(human1Client.hProcess);
-            CloseHandle(human1Client.hPipe);
-        }
-        if (human2Client.hProcess != NULL) {
-            TerminateProcess(human2Client.hProcess, 0);
-            CloseHandle(human2Client.hProcess);
-            CloseHandle(human2Client.hPipe);
+    // Microseconds per move of each game, without and with metrics. The games alternate so
+    // both see the same conditions, and the medians are compared so a game stalled by the
+    // scheduler does not swamp the difference being measured.
+    std::vector<double> microsPerMove[2];
+    for (int i = 0; i < 2 * games; ++i) {
+        int enabled = i % 2;
+        metrics.setEnabled(enabled != 0);
+        unsigned long long start = clockTicks();
+        long long played = playPipeGames<Board>(1, client1, client2);
+        unsigned long long ticks = clockTicks() - start;
+        if (played <= 0) {
+            metrics.setEnabled(true);
+            return false;
         }
+        microsPerMove[enabled].push_back(ticksToMillis(ticks) * 1000.0 / played);
     }
-    else if (mode == 2) { // Human vs Bot
-        if (human1Client.hProcess != NULL) {
-            TerminateProcess(human1Client.hProcess, 0);
-            CloseHandle(human1Client.hProcess);
-            CloseHandle(human1Client.hPipe);
-        }
-        if (bot1Client.hProcess != NULL) {
-            TerminateProcess(bot1Client.hProcess, 0);
-            CloseHandle(bot1Client.hProcess);
-            CloseHandle(bot1Client.hPipe);
-        }
+    metrics.setEnabled(true);
+
+    for (std::vector<double>& samples : microsPerMove) {
+        std::nth_element(samples.begin(), samples.begin() + samples.size() / 2, samples.end());
     }
-    else if (mode == 3) { // Bot vs Bot
-        if (bot1Client.hProcess != NULL) {
-            TerminateProcess(bot1Client.hProcess, 0);
-            CloseHandle(bot1Client.hProcess);
-            CloseHandle(bot1Client.hPipe);
-        }
-        if (bot2Client.hProcess != NULL) {
-            TerminateProcess(bot2Client.hProcess, 0);
-            CloseHandle(bot2Client.hProcess);
-            CloseHandle(bot2Client.hPipe);
-        }
+    double microsWithout = microsPerMove[0][games / 2];
+    double microsWith = microsPerMove[1][games / 2];
+    std::wcout << L"  " << name << L": " << microsWithout << L" us/move without metrics, "
+        << microsWith << L" us/move with (medians), overhead "
+        << (microsWith - microsWithout) * 100.0 / microsWithout << L" %" << std::endl;
+    return true;
+}
+
+// Function to report the metrics overhead for both rulesets, Bot1 (X) against Bot2 (O)
+int runMetricsOverheadBenchmark(int games) {
+    StandbyPool pool;
+    StandbyClient standby1;
+    StandbyClient standby2;
+    ClientProcess client1;
+    ClientProcess client2;
+    bool ok = pool.take(kBot1ExePath, standby1) && pool.take(kBot2ExePath, standby2) &&
+        activateStandbyClient(standby1, L"\\\\.\\pipe\\TicTacToeBot1", client1) &&
+        activateStandbyClient(standby2, L"\\\\.\\pipe\\TicTacToeBot2", client2);
+
+    if (ok) {
+        std::wcout << L"Metrics overhead on the move path over " << games << L" games:" << std::endl;
+        ok = reportMetricsOverhead<TicTacToeBoard>(L"Classic", games, client1, client2) &&
+            reportMetricsOverhead<UltimateBoard>(L"Ultimate", games, client1, client2);
+    }
+    if (!ok) {
+        std::wcerr << L"Bots failed during the benchmark." << std::endl;
     }
 
-    // Wait for user input before exiting
-    std::wcout << L"Press Enter to exit...";
-    std::wcin.get();
+    discardStandbyClient(standby1);
+    discardStandbyClient(standby2);
+    closeClient(client1);
+    closeClient(client2);
+    pool.drain();
+    return ok ? 0 : 1;
 }
 
 // Main Function
-int wmain() {
+int wmain(int argc, wchar_t* argv[]) {
     // Set the console to handle Unicode output
     _setmode(_fileno(stdout), _O_U16TEXT);
     _setmode(_fileno(stderr), _O_U16TEXT);
 
+    // main.exe --startup-benchmark [iterations]
+    if (argc >= 2 && std::wstring(argv[1]) == L"--startup-benchmark") {
+        int iterations = (argc >= 3) ? _wtoi(argv[2]) : 10;
+        runStartupBenchmark(iterations > 0 ? iterations : 10);
+        return 0;
+    }
+
+#ifdef TTT_ALLOCATION_CHECK
+    // main.exe --allocation-check [games]
+    if (argc >= 2 && std::wstring(argv[1]) == L"--allocation-check") {
+        int games = (argc >= 3) ? _wtoi(argv[2]) : 1000;
+        return runAllocationCheck(games > 0 ? games : 1000);
+    }
+#endif
+
+    // main.exe --metrics-overhead [games]
+    if (argc >= 2 && std::wstring(argv[1]) == L"--metrics-overhead") {
+        int games = (argc >= 3) ? _wtoi(argv[2]) : 2000;
+        return runMetricsOverheadBenchmark(games > 0 ? games : 2000);
+    }
+
+    // main.exe --spectator-writer [seconds]
+    if (argc >= 2 && std::wstring(argv[1]) == L"--spectator-writer") {
+        int seconds = (argc >= 3) ? _wtoi(argv[2]) : 10;
+        return runSpectatorWriter(seconds > 0 ? seconds : 10);
+    }
+
+    // main.exe --perft [depth]
+    if (argc >= 2 && std::wstring(argv[1]) == L"--perft") {
+        int depth = (argc >= 3) ? _wtoi(argv[2]) : 6;
+        runPerftBenchmark(depth > 0 ? depth : 6);
+        return 0;
+    }
+
     int mode;
     std::wcout << L"Select game mode:\n";
     std::wcout << L"1. Human vs Human\n";
@@ -407,6 +1175,41 @@ int wmain() {
         return 1;
     }
 
-    playGame(mode);
+    // Start this mode's clients now, so they initialize while the ruleset is chosen
+    if (mode == 1) {
+        standbyPool.fill(kHumanExePath, 2);
+    }
+    else if (mode == 2) {
+        standbyPool.fill(kHumanExePath, 1);
+        standbyPool.fill(kBot1ExePath, 1);
+    }
+    else {
+        standbyPool.fill(kBot1ExePath, 1);
+        standbyPool.fill(kBot2ExePath, 1);
+    }
+
+    int ruleset;
+    std::wcout << L"Select ruleset:\n";
+    std::wcout << L"1. Classic\n";
+    std::wcout << L"2. Ultimate\n";
+    std::wcout << L"Enter your choice: ";
+    std::wcin >> ruleset;
+
+    if (ruleset != 1 && ruleset != 2) {
+        std::wcerr << L"Invalid ruleset." << std::endl;
+        standbyPool.drain();
+        return 1;
+    }
+
+    // Metrics are refreshed every second for a Prometheus file-based scrape
+    metrics.startExport(L"ttt_metrics.prom", 1000);
+    if (ruleset == 1) {
+        playGame<TicTacToeBoard>(mode);
+    }
+    else {
+        playGame<UltimateBoard>(mode);
+    }
+    metrics.stopExport();
+    standbyPool.drain();
     return 0;
 }